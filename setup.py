@@ -79,6 +79,7 @@ setup(
     author_email='mail@sapphire.in.net',
     license='Apache2.0',
     keywords='graph graph-processing graph-analysis',
+    install_requires=['numpy'],
     ext_modules=[CMakeExtension('hoshizora')],
     cmdclass=dict(build_ext=CMakeBuild),
     zip_safe=False,
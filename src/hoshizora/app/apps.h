@@ -7,66 +7,205 @@
 #include "hoshizora/core/graph.h"
 #include "hoshizora/core/includes.h"
 #include "hoshizora/core/io.h"
+#include "hoshizora/core/output.h"
 #include <iostream>
+#include <limits>
 #include <map>
 #include <set>
 #include <utility>
 
 namespace hoshizora {
-std::vector<std::string> pagerank(const std::string &file_name,
-                                  const u32 num_iters) {
-  using _Graph = Graph<u32, u32 /*empty_t*/, empty_t, f32, f32>;
+using PageRankGraph = Graph<u32, u32 /*empty_t*/, empty_t, f32, f32>;
+using ClusteringGraph = Graph<u32,                 // ID: cluster_id
+                              f32,                 // VProp: e_{ii}
+                              f32,                 // EProp: e_{ij}
+                              std::pair<u32, f64>, // VData: (new cluster_id,
+                                                   // gain)
+                              f64>;                // EData: modularity gain
+// the same for symmetric inputs, see is_undirected
+using UndirectedPageRankGraph =
+    Graph<u32, u32 /*empty_t*/, empty_t, f32, f32, false>;
+using UndirectedClusteringGraph =
+    Graph<u32, f32, f32, std::pair<u32, f64>, f64, false>;
+
+// a symmetric (not skew-symmetric) Matrix Market file is loaded as an
+// undirected graph instead of both directions of each entry
+bool is_undirected(const std::string &file_name, const LoadOptions &options) {
+  return IO::is_undirected(IO::sniff_file(file_name, options.format));
+}
+
+struct ResultQuery {
+  u64 top_k = 0; // 0: no limit
+  f32 threshold = -std::numeric_limits<f32>::infinity();
+  std::vector<u64> vertices; // original IDs, empty: all vertices
+};
+
+// runs PageRank on a built graph and hands the executor holding the final
+// scores to `f`
+template <class G, class Func /*(executor)*/>
+void with_pagerank(G &graph, const u32 num_iters, Func f) {
   debug::logger->info("#numa nodes: {}", loop::num_numa_nodes);
   debug::logger->info("#threads: {}", loop::num_threads);
   debug::logger->info("#iters: {}", num_iters);
-  debug::point("started");
-  auto edge_list = IO::from_file(file_name);
-  debug::point("loaded");
-  auto graph = _Graph::from_edge_list(edge_list);
   debug::point("converted");
-  PageRankKernel<_Graph> kernel{};
-  BulkSyncGASExecutor<PageRankKernel<_Graph>> executor(kernel, graph,
-                                                       num_iters);
-  const auto result = executor.run();
+  PageRankKernel<G> kernel{};
+  BulkSyncGASExecutor<PageRankKernel<G>> executor(kernel, graph, num_iters);
+  executor.compute();
   debug::point("done");
+  debug::logger->info("graph memory: {} bytes", graph.memory_usage());
+  f(executor);
+  debug::point("written");
 
-  debug::report("started", "loaded");
-  debug::report("loaded", "converted");
   debug::report("converted", "done");
+  debug::report("done", "written");
   // loop::quit();
+}
+
+// loads the graph first
+template <class Func /*(executor)*/>
+void with_pagerank(const std::string &file_name, const u32 num_iters,
+                   const LoadOptions &options, Func f) {
+  debug::point("started");
+  auto load_options = options;
+  load_options.direction = PageRankKernel<PageRankGraph>::direction;
+  if (is_undirected(file_name, options)) {
+    auto graph = IO::load<UndirectedPageRankGraph>(file_name, load_options);
+    with_pagerank(graph, num_iters, f);
+  } else {
+    auto graph = IO::load<PageRankGraph>(file_name, load_options);
+    with_pagerank(graph, num_iters, f);
+  }
 
+  debug::report("started", "loaded");
+  debug::report("loaded", "converted");
+}
+
+// (original ID, score) of the vertices matching all conditions of `query`:
+// highest first with top_k, else in vertex (or the given) order
+template <class Executor>
+std::vector<std::pair<u64, f32>> select_results(const Executor &executor,
+                                        const ResultQuery &query) {
+  using ID = typename Executor::ID;
+  const auto &graph = *executor.curr_graph;
+
+  std::vector<std::pair<ID, f32>> selected;
+  if (!query.vertices.empty()) {
+    std::vector<ID> vertices;
+    vertices.reserve(query.vertices.size());
+    for (const auto v : query.vertices) {
+      vertices.emplace_back(graph.internal_id(v));
+    }
+    selected = executor.subset(vertices);
+    if (query.top_k > 0) {
+      std::stable_sort(selected.begin(), selected.end(),
+                       query::ranks_higher<ID, f32>);
+    }
+  } else if (query.top_k > 0) {
+    selected = executor.top_k(query.top_k);
+  } else {
+    selected = executor.threshold(query.threshold);
+  }
+
+  // top-k of the vertices above a threshold is a prefix of the top-k
+  std::vector<std::pair<u64, f32>> result;
+  for (const auto &pair : selected) {
+    if (query.top_k > 0 && result.size() == query.top_k) {
+      break;
+    }
+    if (!(pair.second < query.threshold)) {
+      result.emplace_back(graph.external_id(pair.first), pair.second);
+    }
+  }
+  return result;
+}
+
+std::vector<std::string> pagerank(PageRankGraph &graph, const u32 num_iters) {
+  std::vector<std::string> result;
+  with_pagerank(graph, num_iters, [&result](const auto &executor) {
+    result = executor.kernel.result(*executor.curr_graph);
+  });
+  return result;
+}
+
+std::vector<std::string>
+pagerank(const std::string &file_name, const u32 num_iters,
+         const LoadOptions &options = LoadOptions()) {
+  std::vector<std::string> result;
+  with_pagerank(file_name, num_iters, options,
+                [&result](const auto &executor) {
+                  result = executor.kernel.result(*executor.curr_graph);
+                });
+  return result;
+}
+
+// writes scores straight from the graph to `fd`
+void pagerank(const std::string &file_name, const u32 num_iters,
+              const LoadOptions &options, const output::Mode mode,
+              const int fd) {
+  with_pagerank(file_name, num_iters, options,
+                [mode, fd](const auto &executor) {
+                  const auto &graph = *executor.curr_graph;
+                  output::write(fd, mode, graph.v_data, graph.external_ids);
+                });
+}
+
+std::vector<std::pair<u64, f32>> pagerank(PageRankGraph &graph,
+                                          const u32 num_iters,
+                                          const ResultQuery &query) {
+  std::vector<std::pair<u64, f32>> result;
+  with_pagerank(graph, num_iters, [&](const auto &executor) {
+    result = select_results(executor, query);
+  });
+  return result;
+}
+
+std::vector<std::pair<u64, f32>>
+pagerank(const std::string &file_name, const u32 num_iters,
+         const LoadOptions &options, const ResultQuery &query) {
+  std::vector<std::pair<u64, f32>> result;
+  with_pagerank(file_name, num_iters, options, [&](const auto &executor) {
+    result = select_results(executor, query);
+  });
   return result;
 }
 
 // FIXME: Just garbage
-std::vector<u32> clustering(const std::string &file_name,
-                            const u32 num_clusters_hint, const f64 threshold) {
-  using G = Graph<u32,                 // ID: cluster_id
-                  u32,                 // VProp: e_{ii}
-                  u32,                 // EProp: e_{ij}
-                  std::pair<u32, f64>, // VData: (new cluster_id, gain)
-                  f64>;                // EData: modularity gain
-  auto edge_list = IO::from_file(file_name);
-  auto graph = G::from_edge_list(edge_list);
+// [vertex] -> cluster ID. `graph` is taken over, a rebind() of a built graph
+// shares its topology without touching it
+template <class G>
+std::vector<u32> clustering(G graph, const u32 num_clusters_hint,
+                            const f64 threshold) {
+  using ID = typename G::_ID;
+  using VProp = typename G::_VProp;
+  using EProp = typename G::_EProp;
+  if (graph.in_indices_is_compressed) {
+    throw std::invalid_argument("clustering cannot walk compressed in-edges");
+  }
   const auto num_vertices = graph.num_vertices;
   // init e_props and cluster_ids
-  std::vector<std::unordered_map<G::_ID, G::_EProp>> edge_weights;
+  std::vector<std::unordered_map<ID, EProp>> edge_weights;
   edge_weights.reserve(graph.num_vertices);
   std::vector<u32> cluster_ids{}; // [orig_id] -> cluster_id
   std::map<u32, std::set<u32>>
       inv_cluster_ids{}; // [cluster_id] -> inner_orig_ids[]
   cluster_ids.reserve(graph.num_vertices);
+  f64 total_weight = 0;
   for (u32 src = 0; src < graph.num_vertices; ++src) {
     cluster_ids.emplace_back(src);
     std::set<u32> s = {src};
     inv_cluster_ids.emplace(src, s);
-    edge_weights.emplace_back(std::unordered_map<G::_ID, G::_EProp>());
-    for (u32 i = 0, degree = graph.out_degrees(src); i < degree; ++i) {
-      const auto dst = graph.out_neighbors(src)[i];
-      edge_weights.back().emplace(dst, 1); // let initial edge weight be 1
-    }
+    edge_weights.emplace_back(std::unordered_map<ID, EProp>());
+    auto index = graph.out_offsets(src);
+    graph.each_out_neighbor(src, [&](const u32 dst) {
+      // weights of the input if any, otherwise let initial edge weight be 1
+      const EProp weight =
+          graph.out_e_props.size() > 0 ? graph.out_e_props(index) : 1;
+      edge_weights.back().emplace(dst, weight);
+      total_weight += weight;
+      index++;
+    });
   }
-  graph.num_all_edges = graph.num_edges;
+  graph.num_all_edges = total_weight;
   graph.e_props = edge_weights;
   ClusteringLouvain<G> kernel{threshold};
   BulkSyncGASExecutor<ClusteringLouvain<G>> executor{kernel, graph, 1};
@@ -125,38 +264,48 @@ std::vector<u32> clustering(const std::string &file_name,
     const u32 new_num_vertices = _inv_cluster_ids.size();
     std::vector<std::set<u32>> _adjacency_list{new_num_vertices,
                                                std::set<u32>{}};
-    std::vector<std::unordered_map<G::_ID, G::_EProp>> new_edge_weights{
-        new_num_vertices, std::unordered_map<G::_ID, G::_EProp>{}};
-    std::vector<u32> v_props(new_num_vertices);
+    std::vector<std::unordered_map<ID, EProp>> new_edge_weights{
+        new_num_vertices, std::unordered_map<ID, EProp>{}};
+    // weights are summed: of each slot of the input graph (parallel edges
+    // apart) on the first level, of the contracted edges on the others
+    std::vector<VProp> v_props(new_num_vertices);
     for (const auto &kv : _inv_cluster_ids) {
       const auto src = packed_ids[kv.first];
       for (const auto inner : kv.second) {
-        const auto inner_nghs = graph.out_neighbors(inner);
-        for (u32 i = 0, deg = graph.out_degrees(inner); i < deg; ++i) {
-          const auto ngh = inner_nghs[i];
+        if (!graph.v_props.empty()) {
+          v_props[src] += graph.v_props[inner];
+        }
+        auto index = graph.out_offsets(inner);
+        graph.each_out_neighbor(inner, [&](const u32 ngh) {
+          const auto weight = graph.out_e_props.size() > 0
+                                  ? graph.out_e_props(index)
+                                  : graph.e_props[inner].at(ngh);
+          index++;
           const auto ngh_cl = packed_ids[cluster_ids[ngh]];
           if (ngh_cl == src) {
-            v_props[src]++;
+            v_props[src] += weight;
           } else {
-            auto &map = new_edge_weights[src];
-            if (map.find(ngh_cl) == map.end()) {
-              map.emplace(ngh_cl, 1);
-            } else {
-              map[ngh_cl]++;
-            }
+            new_edge_weights[src][ngh_cl] += weight;
             _adjacency_list[src].emplace(ngh_cl);
           }
-        }
+        });
       }
     }
-    std::vector<std::vector<u32>> adjacency_list{};
-    adjacency_list.reserve(new_num_vertices);
+    // sets are already sorted, so they are packed as CSR as they are
+    std::vector<u32> offsets(new_num_vertices + 1, 0);
+    for (u32 v = 0; v < new_num_vertices; ++v) {
+      offsets[v + 1] = offsets[v] + _adjacency_list[v].size();
+    }
+    std::vector<u32> indices;
+    indices.reserve(offsets[new_num_vertices]);
     for (const auto &ngh : _adjacency_list) {
-      adjacency_list.emplace_back(std::vector<u32>(ngh.begin(), ngh.end()));
+      indices.insert(indices.end(), ngh.begin(), ngh.end());
     }
 
     auto num_all_edges = graph.num_all_edges;
-    graph = G::from_adjacency_list(adjacency_list); // FIXME: Large memory leak
+    // chunks of the previous graph are freed here
+    graph = G::from_csr(offsets.data(), indices.data(), new_num_vertices,
+                        new_num_vertices);
     graph.e_props = new_edge_weights;
     graph.v_props = v_props;
     graph.num_all_edges = num_all_edges;
@@ -173,5 +322,24 @@ std::vector<u32> clustering(const std::string &file_name,
   }
   return res;
 }
+
+// `external_ids` receives original IDs of the returned rows if remapped
+std::vector<u32> clustering(const std::string &file_name,
+                            const u32 num_clusters_hint, const f64 threshold,
+                            const LoadOptions &options = LoadOptions(),
+                            std::vector<u64> *external_ids = nullptr) {
+  if (is_undirected(file_name, options)) {
+    auto graph = IO::load<UndirectedClusteringGraph>(file_name, options);
+    if (external_ids != nullptr) {
+      *external_ids = graph.external_ids;
+    }
+    return clustering(std::move(graph), num_clusters_hint, threshold);
+  }
+  auto graph = IO::load<ClusteringGraph>(file_name, options);
+  if (external_ids != nullptr) {
+    *external_ids = graph.external_ids;
+  }
+  return clustering(std::move(graph), num_clusters_hint, threshold);
+}
 } // namespace hoshizora
 #endif // HOSHIZORA_APPS_H
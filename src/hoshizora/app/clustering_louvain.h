@@ -27,14 +27,16 @@ template <class Graph> struct ClusteringLouvain : Kernel<Graph> {
                 Graph &graph) override {
     // q_{src}
     // Need only the beginning(=|V| times), but currently called |E| times
-    u32 sum = graph.v_props.empty() ? 0 : graph.v_props[src];
-    for (u32 i = 0, degree = graph.out_degrees(src); i < degree; ++i) {
-      const auto ngh = graph.out_neighbors(src)[i];
-      sum += graph.e_props[src].at(ngh);
-    }
-    for (u32 i = 0, deg = graph.in_degrees(src); i < deg; ++i) {
-      const auto ngh = graph.in_neighbors(src)[i];
-      sum += graph.e_props[ngh].at(src);
+    f64 sum = graph.v_props.empty() ? 0 : graph.v_props[src];
+    f64 out_sum = 0;
+    graph.each_out_neighbor(
+        src, [&](const ID ngh) { out_sum += graph.e_props[src].at(ngh); });
+    sum += out_sum;
+    if (Graph::is_directed) {
+      graph.each_in_neighbor(
+          src, [&](const ID ngh) { sum += graph.e_props[ngh].at(src); });
+    } else {
+      sum += out_sum; // in-edges are the out-edges, e_props is symmetric
     }
     const f64 q = sum / (2.0 * graph.num_all_edges);
     graph.v_data(src) = std::make_pair(src, q);
@@ -45,12 +47,10 @@ template <class Graph> struct ClusteringLouvain : Kernel<Graph> {
                const EData curr_val /*q_{src}*/,
                const Graph &graph) const override {
     // if no outgoing edge, not initialize at scatter
-    if (graph.out_degrees(dst) == 0) {
-      u32 sum = graph.v_props.empty() ? 0 : graph.v_props[dst];
-      for (u32 i = 0, deg = graph.in_degrees(dst); i < deg; ++i) {
-        const auto ngh = graph.in_neighbors(dst)[i];
-        sum += graph.e_props[ngh].at(dst);
-      }
+    if (graph.out_degree(dst) == 0) {
+      f64 sum = graph.v_props.empty() ? 0 : graph.v_props[dst];
+      graph.each_in_neighbor(
+          dst, [&](const ID ngh) { sum += graph.e_props[ngh].at(dst); });
       const f64 q = sum / (2.0 * graph.num_all_edges);
       graph.v_data(dst) = std::make_pair(dst, q);
     }
@@ -13,6 +13,8 @@ template <class Graph> struct PageRankKernel : Kernel<Graph> {
   using ID = typename Graph::_ID;
 
   constexpr static auto JUMP_PROB = 0.15;
+  // a rank only depends on the previous ranks of in-neighbors
+  constexpr static auto direction = Direction::In;
 
   VData init(const ID src, const Graph &graph) const {
     //            return 1.0 / graph.num_vertices;
@@ -20,7 +22,7 @@ template <class Graph> struct PageRankKernel : Kernel<Graph> {
   }
 
   EData scatter(const ID src, const ID dst, const VData v_val, Graph &graph) {
-    return v_val / graph.out_degrees(src, nullptr); // TODO: numa_id
+    return v_val / graph.out_degree(src); // TODO: numa_id
   }
 
   EData gather(const ID src, const ID dst, const VData prev_val,
@@ -43,8 +45,17 @@ template <class Graph> struct PageRankKernel : Kernel<Graph> {
   std::vector<std::string> result(const Graph &graph) const {
     std::vector<std::string> results{};
     results.reserve(graph.num_vertices);
-    for (size_t i = 0; i < graph.num_vertices; ++i) {
-      results.emplace_back(std::to_string(graph.v_data(i)));
+    if (graph.external_ids.empty()) {
+      for (const auto value : graph.v_data) {
+        results.emplace_back(std::to_string(value));
+      }
+    } else {
+      // line number no longer tells the vertex
+      ID i = 0;
+      for (const auto value : graph.v_data) {
+        results.emplace_back(std::to_string(graph.external_id(i++)) + "\t" +
+                             std::to_string(value));
+      }
     }
     return results;
   }
@@ -5,25 +5,100 @@
 #include <utility>
 
 namespace hoshizora {
+// e.g. `512M`, `4G`
+static u64 parse_bytes(const std::string &str) {
+  if (str.empty()) {
+    return 0;
+  }
+  char *suffix = nullptr;
+  const auto value = std::strtoull(str.c_str(), &suffix, 10);
+  switch (*suffix) {
+  case 'K':
+  case 'k':
+    return value << 10u;
+  case 'M':
+  case 'm':
+    return value << 20u;
+  case 'G':
+  case 'g':
+    return value << 30u;
+  default:
+    return value;
+  }
+}
+
 void main(int argc, char *argv[]) {
-  const auto type = std::string(argv[1]);
-  const auto file_name = std::string(argv[2]);
+  // positional arguments and `--key=value` options in any order
+  std::vector<std::string> args;
+  std::map<std::string, std::string> opts;
+  for (int i = 1; i < argc; ++i) {
+    const auto arg = std::string(argv[i]);
+    if (arg.compare(0, 2, "--") == 0) {
+      const auto eq = arg.find('=');
+      opts[arg.substr(2, eq == std::string::npos ? eq : eq - 2)] =
+          eq == std::string::npos ? "" : arg.substr(eq + 1);
+    } else {
+      args.emplace_back(arg);
+    }
+  }
+
+  const auto type = args[0];
+  const auto file_name = args[1];
+
+  LoadOptions load_options;
+  if (!opts["input-format"].empty()) {
+    load_options.format = parse_format(opts["input-format"]);
+  }
+  load_options.snapshot_file = opts["snapshot"];
+  load_options.memory_budget = parse_bytes(opts["memory-budget"]);
+  if (!opts["spill-dir"].empty()) {
+    load_options.spill_dir = opts["spill-dir"];
+  }
+  load_options.remap_ids = opts.count("remap-ids") > 0;
+  load_options.cleanup.duplicates = opts.count("dedup") > 0;
+  load_options.cleanup.self_loops = opts.count("drop-self-loops") > 0;
+  if (!opts["reorder"].empty()) {
+    load_options.reordering = parse_reordering(opts["reorder"]);
+  }
+  load_options.compress = opts.count("compress") > 0;
+
+  const auto output_mode = output::parse_mode(opts["format"]);
 
   init();
 
   if (type == "pagerank") {
-    const auto num_iters = (u32)std::strtol(argv[3], nullptr, 10);
-    const auto res = pagerank(file_name, num_iters);
-    for (const auto &el : res) {
-      printf("%s\n", el.c_str());
+    const auto num_iters = (u32)std::strtol(args[2].c_str(), nullptr, 10);
+    if (opts.count("top-k") == 0 && opts.count("threshold") == 0) {
+      pagerank(file_name, num_iters, load_options, output_mode,
+               STDOUT_FILENO);
+    } else {
+      // only the matching vertices, always with their IDs
+      ResultQuery query;
+      query.top_k = std::strtoull(opts["top-k"].c_str(), nullptr, 10);
+      if (!opts["threshold"].empty()) {
+        query.threshold = std::stof(opts["threshold"]);
+      }
+      const auto res = pagerank(file_name, num_iters, load_options, query);
+      std::vector<u64> ids;
+      std::vector<f32> scores;
+      for (const auto &el : res) {
+        ids.emplace_back(el.first);
+        scores.emplace_back(el.second);
+      }
+      colle::DiscreteArray<f32> values;
+      values.add(scores.data(), scores.size());
+      output::write(STDOUT_FILENO, output_mode, values, ids);
     }
   } else if (type == "clustering") {
-    const auto num_clusters_hint = (u32)std::strtol(argv[3], nullptr, 10);
-    const auto threshold = argc > 4 ? std::stof(argv[4]) : 0.00003;
-    auto res = clustering(argv[2], num_clusters_hint, threshold);
-    for (const auto &el : res) {
-      printf("%d\n", el);
-    }
+    const auto num_clusters_hint =
+        (u32)std::strtol(args[2].c_str(), nullptr, 10);
+    const auto threshold = args.size() > 3 ? std::stof(args[3]) : 0.00003;
+    std::vector<u64> external_ids;
+    auto res = clustering(file_name, num_clusters_hint, threshold,
+                          load_options, &external_ids);
+    colle::DiscreteArray<u32> clusters;
+    clusters.add(res.data(), res.size());
+    output::write(STDOUT_FILENO, output_mode, clusters, external_ids);
   } else {
     printf("'%s' is not specified\n", type.c_str());
   }
@@ -31,6 +106,13 @@ void main(int argc, char *argv[]) {
 } // namespace hoshizora
 
 int main(int argc, char *argv[]) {
-  hoshizora::main(argc, argv);
+  // errors of any thread end up here, so that resources (e.g. spilled
+  // runs) are released on the way
+  try {
+    hoshizora::main(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  }
   return 0;
 }
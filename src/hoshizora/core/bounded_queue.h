@@ -0,0 +1,50 @@
+#ifndef HOSHIZORA_BOUNDED_QUEUE_H
+#define HOSHIZORA_BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+
+#include "hoshizora/core/includes.h"
+
+namespace hoshizora {
+// blocking multi-producer/multi-consumer queue of at most `capacity` items
+template <class T> struct BoundedQueue {
+  const u64 capacity;
+  std::queue<T> items;
+  bool closed = false;
+  std::mutex mtx;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+
+  explicit BoundedQueue(const u64 capacity) : capacity(capacity) {}
+
+  void push(T item) {
+    auto lock = std::unique_lock<std::mutex>(mtx);
+    not_full.wait(lock, [this]() { return items.size() < capacity; });
+    items.push(std::move(item));
+    not_empty.notify_one();
+  }
+
+  // false once closed and drained
+  bool pop(T &item) {
+    auto lock = std::unique_lock<std::mutex>(mtx);
+    not_empty.wait(lock, [this]() { return !items.empty() || closed; });
+    if (items.empty()) {
+      return false;
+    }
+    item = std::move(items.front());
+    items.pop();
+    not_full.notify_one();
+    return true;
+  }
+
+  void close() {
+    auto lock = std::unique_lock<std::mutex>(mtx);
+    closed = true;
+    not_empty.notify_all();
+  }
+};
+} // namespace hoshizora
+
+#endif // HOSHIZORA_BOUNDED_QUEUE_H
@@ -8,11 +8,13 @@
 #include "hoshizora/core/executor.h"
 #include "hoshizora/core/includes.h"
 #include "hoshizora/core/loop.h"
+#include "hoshizora/core/query.h"
 
 namespace hoshizora {
 template <class Kernel> struct BulkSyncGASExecutor : Executor<Kernel> {
   using Graph = typename Kernel::_Graph;
   using ID = typename Kernel::_Graph::_ID;
+  using VData = typename Kernel::_Graph::_VData;
 
   Kernel kernel;
 
@@ -28,13 +30,28 @@ template <class Kernel> struct BulkSyncGASExecutor : Executor<Kernel> {
 
   const u32 num_iters;
 
+  // values being pulled in an iteration, swapped with v_data after it
+  colle::DiscreteArray<VData> next_v_data;
+
+  static_assert(Kernel::direction != Direction::Out,
+                "values are always summed over in-edges");
+
   explicit BulkSyncGASExecutor(const Kernel &kernel, Graph &graph,
                                u32 num_iters)
       : kernel(kernel), prev_graph(&graph), curr_graph(&graph),
         num_vertices(graph.num_vertices), num_edges(graph.num_edges),
         thread_pool(num_threads), num_iters(num_iters) {
+    assert(graph.has_in_edges());
+    // compressed in-lists are only walked in order by pull()
+    assert(!graph.in_indices_is_compressed ||
+           Kernel::direction == Direction::In);
     curr_graph->set_v_data(true);
-    curr_graph->set_e_data(true);
+    if (Kernel::direction == Direction::Both) {
+      assert(graph.direction == Direction::Both);
+      curr_graph->set_e_data(true);
+    } else {
+      next_v_data = curr_graph->alloc_v_data();
+    }
   }
 
   // template <class Func> inline void push_tasks(Func f, ID *boundaries) {
@@ -51,24 +68,24 @@ template <class Kernel> struct BulkSyncGASExecutor : Executor<Kernel> {
   //}
 
   template <class Func> inline void push_tasks(Func f, ID *boundaries) {
-    auto tasks = new std::vector<std::function<void()>>();
+    std::vector<std::function<void()>> tasks;
     loop::each_thread(boundaries,
                       [&](u32 thread_id, u32 numa_id, u32 lower, u32 upper) {
-                        tasks->emplace_back([=, &f]() {
+                        tasks.emplace_back([=]() {
                           for (ID dst = lower; dst < upper; ++dst) {
                             f(dst, thread_id);
                           }
                         });
                       });
-    thread_pool.push_tasks(tasks);
+    thread_pool.push_tasks(std::move(tasks));
   }
 
   template <class Func>
   inline void push_tasks(Func f, ID *boundaries, u32 iter) {
-    auto tasks = new std::vector<std::function<void()>>();
+    std::vector<std::function<void()>> tasks;
     loop::each_thread(boundaries,
                       [&](u32 thread_id, u32 numa_id, u32 lower, u32 upper) {
-                        tasks->emplace_back([=, &f]() {
+                        tasks.emplace_back([=]() {
                           for (ID dst = lower; dst < upper; ++dst) {
                             f(dst, thread_id);
                           }
@@ -77,40 +94,36 @@ template <class Kernel> struct BulkSyncGASExecutor : Executor<Kernel> {
                           }
                         });
                       });
-    thread_pool.push_tasks(tasks);
+    thread_pool.push_tasks(std::move(tasks));
   }
 
-  template <
-      class
-      Func /*(from, to, thread_id, numa_id, local_offset, local_idx, global_offset)*/>
-  inline void push_tasks(Func f, ID *boundaries, u32 iter,
-                         colle::DiscreteArray<u8> &indices) {
-    auto tasks = new std::vector<std::function<void()>>();
-
-    loop::each_thread(boundaries, [&](u32 thread_id, u32 numa_id, u32 lower,
-                                      u32 upper, u32 acc_num_srcs) {
-      const auto num_inner_vertices = upper - lower;
-      tasks->emplace_back([=, &f, &indices]() {
-        indices.foreach (thread_id, num_inner_vertices,
-                         [=](ID dst, ID local_offset, ID _global_idx,
-                             ID local_idx, ID global_offset) {
-                           f(acc_num_srcs + _global_idx, dst, thread_id,
-                             numa_id, local_offset, local_idx, global_offset);
-                         });
-
-        if (thread_id == num_threads - 1) {
-          SPDLOG_DEBUG(debug::logger, "fin iter: {}", iter);
-        }
-      });
-    });
-
-    thread_pool.push_tasks(tasks);
+  // as above, passing the byte where the in-list of `dst` starts in a chunk
+  // of compressed lists (see Graph::each_in_neighbor) from one destination
+  // to the next, as returned by `f`
+  template <class Func /*(dst, thread_id, pos) -> next pos*/>
+  inline void push_in_list_tasks(Func f, ID *boundaries, u32 iter) {
+    std::vector<std::function<void()>> tasks;
+    loop::each_thread(boundaries,
+                      [&](u32 thread_id, u32 numa_id, u32 lower, u32 upper) {
+                        tasks.emplace_back([=]() {
+                          u64 pos = 0;
+                          for (ID dst = lower; dst < upper; ++dst) {
+                            pos = f(dst, thread_id, pos);
+                          }
+                          if (thread_id == num_threads - 1) {
+                            SPDLOG_DEBUG(debug::logger, "fin iter: {}", iter);
+                          }
+                        });
+                      });
+    thread_pool.push_tasks(std::move(tasks));
   }
 
-  std::vector<std::string> run() {
+  // runs all iterations, leaving final values in curr_graph->v_data
+  void compute() {
     for (auto iter = 0u; iter < num_iters; ++iter) {
       SPDLOG_DEBUG(debug::logger, "push iter: {}", iter);
-      auto kernel = this->kernel; // FIXME
+      // tasks run after push_tasks returns, so they hold pointers only
+      auto kernel = &this->kernel;
       auto prev_graph = this->prev_graph;
       auto curr_graph = this->curr_graph;
 
@@ -118,7 +131,7 @@ template <class Kernel> struct BulkSyncGASExecutor : Executor<Kernel> {
         push_tasks(
             [kernel, prev_graph](ID src, u32 thread_id /*, u32 numa_id*/) {
               prev_graph->v_data(src, thread_id) =
-                  kernel.init(src, *prev_graph);
+                  kernel->init(src, *prev_graph);
 
               // for (ID i = 0, end = prev_graph->out_degrees[src]; i < end;
               // ++i) {
@@ -128,12 +141,17 @@ template <class Kernel> struct BulkSyncGASExecutor : Executor<Kernel> {
               //}
             },
             prev_graph->out_boundaries);
-      } else {
+      } else if (Kernel::direction == Direction::Both) {
         thread_pool.push_task([prev_graph, curr_graph]() {
           Graph::next(*prev_graph, *curr_graph);
         });
       }
 
+      if (Kernel::direction == Direction::In) {
+        pull(iter);
+        continue;
+      }
+
       // scatter and gather
       // push_tasks(
       //    [kernel, prev_graph, curr_graph](ID src, ID dst, u32 thread_id,
@@ -177,15 +195,17 @@ template <class Kernel> struct BulkSyncGASExecutor : Executor<Kernel> {
 
       // scatter and gather
       push_tasks(
-          [&kernel, prev_graph, curr_graph](ID src, u32 thread_id) {
-            for (ID i = 0, end = prev_graph->out_degrees(src, thread_id);
+          [kernel, prev_graph, curr_graph](ID src, u32 thread_id) {
+            const auto dsts = prev_graph->out_neighbors(src, thread_id);
+            for (ID i = 0, end = prev_graph->out_degree(src, thread_id);
                  i < end; ++i) {
-              const auto dst = prev_graph->out_neighbors(src, thread_id)[i];
+              const auto dst = dsts[i];
               const auto index = prev_graph->out_offsets(src, thread_id) + i;
-              const auto forwarded_index = prev_graph->forward_indices[index];
+              const auto forwarded_index =
+                  prev_graph->forward_index(src, i, index, thread_id);
 
               curr_graph->e_data(forwarded_index /*, thread_id*/) =
-                  kernel.scatter(src, dst, prev_graph->v_data(src, thread_id),
+                  kernel->scatter(src, dst, prev_graph->v_data(src, thread_id),
                                  *prev_graph);
             }
           },
@@ -193,14 +213,16 @@ template <class Kernel> struct BulkSyncGASExecutor : Executor<Kernel> {
 
       push_tasks(
           [kernel, prev_graph, curr_graph](ID src, u32 thread_id) {
-            for (ID i = 0, end = prev_graph->out_degrees(src, thread_id);
+            const auto dsts = prev_graph->out_neighbors(src, thread_id);
+            for (ID i = 0, end = prev_graph->out_degree(src, thread_id);
                  i < end; ++i) {
-              const auto dst = prev_graph->out_neighbors(src, thread_id)[i];
+              const auto dst = dsts[i];
               const auto index = prev_graph->out_offsets(src, thread_id) + i;
-              const auto forwarded_index = prev_graph->forward_indices[index];
+              const auto forwarded_index =
+                  prev_graph->forward_index(src, i, index, thread_id);
 
               curr_graph->e_data(forwarded_index /*, thread_id*/) =
-                  kernel.gather(
+                  kernel->gather(
                       src, dst,
                       prev_graph->e_data(forwarded_index /*, thread_id*/),
                       curr_graph->e_data(forwarded_index /*, thread_id*/),
@@ -209,36 +231,87 @@ template <class Kernel> struct BulkSyncGASExecutor : Executor<Kernel> {
           },
           prev_graph->out_boundaries);
 
-      // sum and apply
+      // sum and apply. in_boundaries are out_boundaries, so v_data and
+      // e_data (by in-edge) of `dst` are in the chunk of this thread
       push_tasks(
-          [&kernel, curr_graph, prev_graph](ID dst, u32 thread_id) {
-            curr_graph->v_data(dst /*, thread_id*/) =
-                kernel.zero(dst, *prev_graph); // TODO
-            for (ID i = 0, end = prev_graph->in_degrees(dst, thread_id);
+          [kernel, curr_graph, prev_graph](ID dst, u32 thread_id) {
+            curr_graph->v_data(dst, thread_id) =
+                kernel->zero(dst, *prev_graph); // TODO
+            const auto srcs = prev_graph->in_neighbors(dst, thread_id);
+            for (ID i = 0, end = prev_graph->in_degree(dst, thread_id);
                  i < end; ++i) {
-              const auto src = prev_graph->in_neighbors(dst, thread_id)[i];
+              const auto src = srcs[i];
               const auto index = prev_graph->in_offsets(dst, thread_id) + i;
 
-              curr_graph->v_data(dst /*, thread_id*/) = kernel.sum(
-                  dst, src, curr_graph->v_data(dst /*, thread_id*/),
-                  curr_graph->e_data(index /*, thread_id*/), *prev_graph);
+              curr_graph->v_data(dst, thread_id) = kernel->sum(
+                  dst, src, curr_graph->v_data(dst, thread_id),
+                  curr_graph->e_data(index, thread_id), *prev_graph);
             }
           },
           prev_graph->in_boundaries, iter);
 
       push_tasks(
-          [&kernel, curr_graph, prev_graph](ID dst, u32 thread_id) {
-            curr_graph->v_data(dst /*, thread_id*/) = kernel.apply(
-                dst, prev_graph->v_data(dst /*, thread_id*/),
-                curr_graph->v_data(dst /*, thread_id*/), *prev_graph);
+          [kernel, curr_graph, prev_graph](ID dst, u32 thread_id) {
+            curr_graph->v_data(dst, thread_id) = kernel->apply(
+                dst, prev_graph->v_data(dst, thread_id),
+                curr_graph->v_data(dst, thread_id), *prev_graph);
           },
           prev_graph->in_boundaries, iter);
     }
 
     thread_pool.quit();
+    next_v_data.clear();
+  }
 
+  // an iteration of an in-only kernel: each destination sums what its
+  // in-neighbors scatter from the previous values, no e_data is involved.
+  // compressed in-lists are decoded as they are summed
+  void pull(const u32 iter) {
+    auto kernel = &this->kernel;
+    auto graph = this->prev_graph;
+    auto next_v_data = &this->next_v_data;
+
+    push_in_list_tasks(
+        [kernel, graph, next_v_data](ID dst, u32 thread_id, u64 pos) {
+          auto sum = kernel->zero(dst, *graph);
+          pos = graph->each_in_neighbor(
+              dst, thread_id, pos, [&](const ID src) {
+                sum = kernel->sum(
+                    dst, src, sum,
+                    kernel->scatter(src, dst, graph->v_data(src), *graph),
+                    *graph);
+              });
+          (*next_v_data)(dst, thread_id) =
+              kernel->apply(dst, graph->v_data(dst, thread_id), sum, *graph);
+          return pos;
+        },
+        graph->in_boundaries, iter);
+
+    thread_pool.push_task(
+        [graph, next_v_data]() { std::swap(graph->v_data, *next_v_data); });
+  }
+
+  std::vector<std::string> run() {
+    compute();
     return kernel.result(*curr_graph);
   }
+
+  // queries on the final values after `compute`, as (vertex, value)
+
+  // k highest values, highest first
+  std::vector<std::pair<ID, VData>> top_k(const u64 k) const {
+    return query::top_k<ID>(curr_graph->v_data, k);
+  }
+
+  // values not lower than `min`, in vertex order
+  std::vector<std::pair<ID, VData>> threshold(const VData min) const {
+    return query::threshold<ID>(curr_graph->v_data, min);
+  }
+
+  std::vector<std::pair<ID, VData>>
+  subset(const std::vector<ID> &vertices) const {
+    return query::subset<ID>(curr_graph->v_data, vertices);
+  }
 };
 } // namespace hoshizora
 
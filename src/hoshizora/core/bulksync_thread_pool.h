@@ -4,6 +4,7 @@
 #include <atomic>
 #include <cassert>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <sstream>
@@ -21,7 +22,7 @@
 namespace hoshizora {
 struct BulkSyncThreadPool {
   std::vector<std::thread> pool;
-  std::vector<std::queue<std::function<void()>> *> task_queues;
+  std::vector<std::unique_ptr<std::queue<std::function<void()>>>> task_queues;
   bool quit_flag = false;
   bool force_quit_flag = false;
   u32 num_threads;
@@ -32,7 +33,8 @@ struct BulkSyncThreadPool {
   explicit BulkSyncThreadPool(u32 num_threads)
       : num_threads(num_threads), barrier(num_threads) {
     for (u32 thread_id = 0; thread_id < num_threads; ++thread_id) {
-      auto queue = new std::queue<std::function<void()>>();
+      std::unique_ptr<std::queue<std::function<void()>>> queue(
+          new std::queue<std::function<void()>>());
 
       // set own thread affinity
 #ifdef __linux__
@@ -56,7 +58,7 @@ struct BulkSyncThreadPool {
         debug::logger->info("No thread affinity")
 #endif
       });
-      task_queues.emplace_back(queue);
+      task_queues.emplace_back(std::move(queue));
     }
 
     for (u32 thread_id = 0; thread_id < num_threads; ++thread_id) {
@@ -100,27 +102,34 @@ struct BulkSyncThreadPool {
     }
   }
 
-  void push_tasks(std::vector<std::function<void()>> *tasks) {
-    assert(num_threads == tasks->size());
+  void push_tasks(std::vector<std::function<void()>> &&tasks) {
+    assert(num_threads == tasks.size());
 
     for (u32 n = 0; n < num_threads; ++n) {
       mtx.lock();
-      task_queues[n]->push(std::move((*tasks)[n]));
+      task_queues[n]->push(std::move(tasks[n]));
       mtx.unlock();
     }
   }
 
+  // lets workers finish queued tasks unless quit already
+  ~BulkSyncThreadPool() { quit(); }
+
   void quit() {
     quit_flag = true;
     for (auto &thread : pool) {
-      thread.join();
+      if (thread.joinable()) {
+        thread.join();
+      }
     }
   }
 
   void force_quit() {
     force_quit_flag = true;
     for (auto &thread : pool) {
-      thread.join();
+      if (thread.joinable()) {
+        thread.join();
+      }
     }
   }
 };
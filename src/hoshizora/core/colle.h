@@ -2,6 +2,9 @@
 #define HOSHIZORA_COLLE_H
 
 #include "hoshizora/core/includes.h"
+#include <algorithm>
+#include <memory>
+#include <utility>
 #include <vector>
 
 namespace hoshizora {
@@ -14,47 +17,159 @@ template <class T> static inline numa_vector<T> *make_numa_vector(u32 numa_id) {
 #endif
 }
 
+// memory blocks (from mem::malloc) behind the chunks of DiscreteArrays,
+// freed once the last array sharing them is gone
+struct Blocks {
+  std::vector<std::pair<void *, u64>> blocks; // (block, bytes)
+
+  Blocks() = default;
+  Blocks(const Blocks &) = delete;
+  Blocks &operator=(const Blocks &) = delete;
+
+  ~Blocks() {
+    for (const auto &block : blocks) {
+      mem::free(block.first, block.second);
+    }
+  }
+
+  u64 bytes() const {
+    u64 sum = 0;
+    for (const auto &block : blocks) {
+      sum += block.second;
+    }
+    return sum;
+  }
+};
+
+/*
+ * chunks, each of `range[n + 1] - range[n]` elements. chunks are views
+ * unless their blocks are passed to `own`, so arrays over mapped or
+ * borrowed memory work as well. move-only; `share` makes another array over
+ * the same chunks explicitly, which keeps owned blocks alive
+ *
+ * a global index finds its chunk in `lookup`, which maps each block of
+ * 2^shift indices to the chunk of its first index. blocks are sized so that
+ * there are LOOKUP_PER_CHUNK of them per chunk on average, so a chunk is
+ * mostly found at once or after a step over a boundary
+ */
 // TODO: SIMD-aware
 template <class T> struct DiscreteArray {
   // TODO: Redundant on each numa node
   std::vector<T *> data;
   std::vector<u32> range;
+  std::shared_ptr<Blocks> blocks; // null if no block is owned
+  std::vector<u32> lookup;        // [index >> shift] -> chunk
+  u32 shift = 0;
+
+  static constexpr u64 LOOKUP_PER_CHUNK = 64;
+
+  DiscreteArray() {
+    range.emplace_back(0);
+    update_lookup();
+  }
+
+  DiscreteArray(const DiscreteArray &) = delete;
+  DiscreteArray &operator=(const DiscreteArray &) = delete;
 
-  DiscreteArray() { range.emplace_back(0); }
+  // leaves `other` empty
+  DiscreteArray(DiscreteArray &&other) : DiscreteArray() { swap(other); }
 
-  DiscreteArray(std::vector<T *> &data, std::vector<u32> &range)
-      : data(data), range(range) {}
+  DiscreteArray &operator=(DiscreteArray &&other) {
+    DiscreteArray(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  void swap(DiscreteArray &other) {
+    data.swap(other.data);
+    range.swap(other.range);
+    blocks.swap(other.blocks);
+    lookup.swap(other.lookup);
+    std::swap(shift, other.shift);
+  }
+
+  DiscreteArray share() const {
+    DiscreteArray array;
+    array.data = data;
+    array.range = range;
+    array.blocks = blocks;
+    array.lookup = lookup;
+    array.shift = shift;
+    return array;
+  }
+
+  // drops all chunks, freeing owned blocks unless shared
+  void clear() { DiscreteArray().swap(*this); }
+
+  u64 size() const { return data.size(); }
 
-  u64 size() { return data.size(); }
+  // bytes of owned blocks, shared ones included
+  u64 bytes() const { return blocks ? blocks->bytes() : 0; }
+
+  // true if chunks are consecutive slices of data[0]
+  bool is_contiguous() const {
+    for (u32 n = 1; n < data.size(); ++n) {
+      if (data[n] != data[0] + range[n]) {
+        return false;
+      }
+    }
+    return true;
+  }
 
   void add(T *datum, size_t length) {
     data.emplace_back(datum);
     range.emplace_back(range.back() + length);
+    update_lookup();
   }
 
   void add(numa_vector<T> &chunk) {
     data.emplace_back(chunk.data());
     range.emplace_back(range.back() + chunk.size());
+    update_lookup();
   }
 
-  void add(numa_vector<T> &&chunk) {
-    data.emplace_back(chunk.data());
-    range.emplace_back(range.back() + chunk.size());
+  // to be called after `range` is changed in place. O(#chunks)
+  void update_lookup() {
+    const u64 length = range.back();
+    const u64 num_blocks = LOOKUP_PER_CHUNK * std::max<u64>(data.size(), 1);
+    shift = 0;
+    while ((length >> shift) > num_blocks) {
+      shift++;
+    }
+    lookup.resize((length >> shift) + 1);
+    u32 n = 0;
+    for (u64 block = 0; block < lookup.size(); ++block) {
+      while (n + 1 < data.size() && (block << shift) >= range[n + 1]) {
+        n++;
+      }
+      lookup[block] = n;
+    }
+  }
+
+  // chunk holding `index` (< range.back())
+  inline u32 chunk_of(u32 index) const {
+    auto n = lookup[index >> shift];
+    while (index >= range[n + 1]) {
+      n++;
+    }
+    return n;
+  }
+
+  // `block` of `length` elements from mem::malloc is freed with this array
+  void own(T *block, u64 length) {
+    if (!blocks) {
+      blocks = std::make_shared<Blocks>();
+    }
+    blocks->blocks.emplace_back(block, sizeof(T) * length);
   }
 
-  // significantly slower than normal index access on a single malloc
-  //[[deprecated("Recommended to call with hint")]]
+  // a lookup and mostly no step, still slower than access with a hint
   T &operator()(u32 index) const {
-    // TODO: sequential search may be faster
-    const auto n = std::distance(begin(range) + 1,
-                                 upper_bound(begin(range), end(range), index));
+    const auto n = chunk_of(index);
     return data[n][index - range[n]];
   }
 
   T &operator()(u32 index, void *dummy) const {
-    // TODO: sequential search may be faster
-    const auto n = std::distance(begin(range) + 1,
-                                 upper_bound(begin(range), end(range), index));
+    const auto n = chunk_of(index);
     return data[n][index - range[n]];
   }
 
@@ -74,6 +189,60 @@ template <class T> struct DiscreteArray {
     return data[n][index - range[n]];
   }
 
+  // elements of a chunk, as in `for (auto &value : array.chunk(n))`
+  struct Chunk {
+    T *first;
+    T *last;
+
+    T *begin() const { return first; }
+    T *end() const { return last; }
+    u64 size() const { return last - first; }
+  };
+
+  Chunk chunk(u32 n) const {
+    return Chunk{data[n], data[n] + (range[n + 1] - range[n])};
+  }
+
+  // walks elements in global order over chunk boundaries, without lookups
+  struct Iterator {
+    const DiscreteArray *array;
+    u32 n;
+    u32 index; // global
+
+    T &operator*() const {
+      return array->data[n][index - array->range[n]];
+    }
+
+    Iterator &operator++() {
+      index++;
+      while (n + 1 < array->data.size() && index >= array->range[n + 1]) {
+        n++;
+      }
+      return *this;
+    }
+
+    bool operator==(const Iterator &other) const {
+      return index == other.index;
+    }
+    bool operator!=(const Iterator &other) const {
+      return index != other.index;
+    }
+  };
+
+  // iterator at global `index` (<= range.back())
+  Iterator at(u32 index) const {
+    if (index >= range.back()) {
+      return end();
+    }
+    return Iterator{this, chunk_of(index), index};
+  }
+
+  Iterator begin() const { return at(0); }
+  Iterator end() const {
+    return Iterator{this, data.empty() ? 0u : static_cast<u32>(data.size() - 1),
+                    range.back()};
+  }
+
   template <
       class
       Func /*(unpacked_datum, local_offset, global_idx, local_idx, global_offset)*/>
@@ -90,27 +259,6 @@ template <class T> struct DiscreteArray {
     }
   }
 };
-
-// template <>
-// template <
-//    class
-//    Func /*(unpacked_datum, local_offset, global_idx, local_idx,
-//    global_offset)*/>
-// void DiscreteArray<u8>::foreach (u32 thread_id, u32 num_inner_lists,
-//                                 Func f) const {
-// this type manages multiple array in a single array like [0,4,2,1,3] as
-// [[0,4,2], [1,3]]
-// const auto global_offset = range[thread_id];
-// compress::multiple::foreach (
-//    data[thread_id], num_inner_lists,
-//    [=, &f](u32 i, u32 local_offset, u32 _global_idx, u32 local_idx) {
-//      f(i,              // el of array (dst)
-//        local_offset,   // offset of each inner array
-//        _global_idx,    // index of inner array (src)
-//        local_idx,      // index of el in inner array
-//        global_offset); // offset of array, which is useful for outside
-//    });
-//}
 } // namespace colle
 } // namespace hoshizora
 #endif // HOSHIZORA_COLLE_H
@@ -1,24 +1,22 @@
-#ifndef COMPRESS_COMMON
-#define COMPRESS_COMMON
+#ifndef HOSHIZORA_COMPRESS_COMMON_H
+#define HOSHIZORA_COMPRESS_COMMON_H
 
 #include <cstdint>
-#include <cstdlib>
+#include <cstring>
 #include <immintrin.h>
-#include <vector>
 
-#include "FastPFor/headers/codecfactory.h"
-#include "hoshizora/core/util/includes.h"
+#include "hoshizora/core/includes.h"
 
-namespace hoshizora::compress {
+namespace hoshizora {
+namespace compress {
 /*
- * external
+ * lists longer than THRESHOLD are bitpacked by `single`, shorter ones are
+ * coded into variable bytes by `multiple`. `single` packs at most SEGMENT
+ * values at once, so that its flags fit in a few hundred bytes of stack;
+ * longer lists are split by `multiple` into segments decoded on their own
  */
-// TODO: use managed thread_id instead of thread_local
-thread_local const auto pfor =
-    new FastPForLib::CompositeCodec<FastPForLib::SIMDFastPFor<8>,
-                                    FastPForLib::VariableByte>();
-
-constexpr auto THRESHOLD = 64ul; // TODO
+constexpr auto THRESHOLD = 64u;
+constexpr auto SEGMENT = 4096u;
 
 /*
  * const value
@@ -242,12 +240,25 @@ static inline __m256i _mm256_slli_epi8(const __m256i a, const u32 count) {
       _mm256_slli_epi32(a, count));
 }
 
+/*
+ * scalars at any byte of a stream
+ */
+template <class T> static inline T load(const u8 *const in) {
+  T value;
+  std::memcpy(&value, in, sizeof(T));
+  return value;
+}
+
+template <class T> static inline void store(u8 *const out, const T value) {
+  std::memcpy(out, &value, sizeof(T));
+}
+
 /*
  * flag pack
  */
 constexpr u32 pack_sizes[16] = {3,  5,  6,  7,  8,  9,  10, 11,
                                 12, 14, 16, 19, 22, 25, 28, 32};
-constexpr u8 pack_sizes_helper[32] = {
+constexpr u8 pack_sizes_helper[33] = {
     /* 32 */ 15, 15, 15, 15,
     /* 28 */ 14, 14, 14,
     /* 25 */ 13, 13, 13,
@@ -263,152 +274,8 @@ constexpr u8 pack_sizes_helper[32] = {
     /*  7 */ 3,
     /*  6 */ 2,
     /*  5 */ 1,  1,
-    /*  3 */ 0,  0,  0};
-
-/*
- * aligned vector
- */
-/*
-template<size_t N>
-struct aligned {
-  template<typename T>
-  struct allocator {
-    using value_type = T;
-
-    allocator() {}
-
-    template<typename U>
-    allocator(const aligned<N>::allocator<U>&) {}
-
-    T *allocate(size_t n) {
-      //return reinterpret_cast<T *>(std::malloc(sizeof(T) * n));
-      return reinterpret_cast<T *>(aligned_alloc(N, sizeof(T) * n));
-    }
-
-    void deallocate(T *p, size_t n) {
-      free(p);
-    }
-  };
-};
-*/
-
-/*
- * https://gist.github.com/donny-dont/1471329
- * for env not supporting `aligned_alloc`
- */
-template <typename T, std::size_t Alignment> class aligned_allocator {
-public:
-  // The following will be the same for virtually all allocators.
-  typedef T *pointer;
-  typedef const T *const_pointer;
-  typedef T &reference;
-  typedef const T &const_reference;
-  typedef T value_type;
-  typedef std::size_t size_type;
-  typedef ptrdiff_t difference_type;
-
-  T *address(T &r) const { return &r; }
-
-  const T *address(const T &s) const { return &s; }
-
-  std::size_t max_size() const {
-    // The following has been carefully written to be independent of
-    // the definition of size_t and to avoid signed/unsigned warnings.
-    return (static_cast<std::size_t>(0) - static_cast<std::size_t>(1)) /
-           sizeof(T);
-  }
-
-  // The following must be the same for all allocators.
-  template <typename U> struct rebind {
-    typedef aligned_allocator<U, Alignment> other;
-  };
-
-  bool operator!=(const aligned_allocator &other) const {
-    return !(*this == other);
-  }
-
-  void construct(T *const p, const T &t) const {
-    void *const pv = static_cast<void *>(p);
-
-    new (pv) T(t);
-  }
-
-  void destroy(T *const p) const { p->~T(); }
-
-  // Returns true if and only if storage allocated from *this
-  // can be deallocated from other, and vice versa.
-  // Always returns true for stateless allocators.
-  bool operator==(const aligned_allocator &other) const { return true; }
-
-  // Default constructor, copy constructor, rebinding constructor, and
-  // destructor. Empty for stateless allocators.
-  aligned_allocator() = default;
-
-  aligned_allocator(const aligned_allocator &) = default;
-
-  template <typename U>
-  aligned_allocator(const aligned_allocator<U, Alignment> &) {}
-
-  ~aligned_allocator() = default;
-
-  // The following will be different for each allocator.
-  T *allocate(const std::size_t n) const {
-    // The return value of allocate(0) is unspecified.
-    // Mallocator returns NULL in order to avoid depending
-    // on malloc(0)'s implementation-defined behavior
-    // (the implementation can define malloc(0) to return NULL,
-    // in which case the bad_alloc check below would fire).
-    // All allocators can return NULL in this case.
-    if (n == 0) {
-      return NULL;
-    }
-
-    // All allocators should contain an integer overflow check.
-    // The Standardization Committee recommends that std::length_error
-    // be thrown in the case of integer overflow.
-    if (n > max_size()) {
-      throw std::length_error(
-          "aligned_allocator<T>::allocate() - Integer overflow.");
-    }
-
-    // Mallocator wraps malloc().
-    void *const pv = _mm_malloc(n * sizeof(T), Alignment);
-
-    // Allocators should throw std::bad_alloc in the case of memory allocation
-    // failure.
-    if (pv == nullptr) {
-      throw std::bad_alloc();
-    }
-
-    return static_cast<T *>(pv);
-  }
-
-  void deallocate(T *const p, const std::size_t n) const {
-    if (!p)
-      _mm_free(p);
-  }
-
-  // The following will be the same for all allocators that ignore hints.
-  template <typename U>
-  T *allocate(const std::size_t n, const U * /* const hint */) const {
-    return allocate(n);
-  }
-
-  // Allocators are not required to be assignable, so
-  // all allocators should have a private unimplemented
-  // assignment operator. Note that this will trigger the
-  // off-by-default (enabled under /Wall) warning C4626
-  // "assignment operator could not be generated because a
-  // base class assignment operator is inaccessible" within
-  // the STL headers, but that warning is useless.
-private:
-  aligned_allocator &operator=(const aligned_allocator &);
-};
-
-template <typename T, size_t N>
-// using aligned_vector = vector<T, aligned<32>::allocator<T>>; // TODO
-using aligned_vector = vector<T, aligned_allocator<T, 32>>; // TODO
-
-template <typename T> using a32_vector = aligned_vector<T, 32>;
-} // namespace hoshizora::compress
-#endif // COMPRESS_COMMON
+    /*  3 */ 0,  0,  0,
+    /*  0 */ 0}; // lzcnt of 0, e.g. a block repeating the previous value
+} // namespace compress
+} // namespace hoshizora
+#endif // HOSHIZORA_COMPRESS_COMMON_H
@@ -1,202 +1,206 @@
-#ifndef MULTIPLE_H
-#define MULTIPLE_H
-
-#include <chrono>
-#include <immintrin.h>
-#include <iostream>
-#include <string>
+#ifndef HOSHIZORA_COMPRESS_MULTIPLE_H
+#define HOSHIZORA_COMPRESS_MULTIPLE_H
 
 #include "hoshizora/core/compress/common.h"
 #include "hoshizora/core/compress/single.h"
-#include "hoshizora/core/util/includes.h"
+#include "hoshizora/core/includes.h"
 
-namespace hoshizora::compress::multiple {
+namespace hoshizora {
+namespace compress {
 /*
- * encode
+ * sorted lists of consecutive vertices, one after another in bytes from a
+ * 32-byte boundary. a list longer than THRESHOLD starts at the next 32-byte
+ * boundary and is coded by `single` in segments of SEGMENT values, each
+ * from its own first value, so that a hub of any degree is decoded segment
+ * by segment within a fixed buffer. shorter ones (mostly padding for
+ * `single`) are deltas in variable bytes: 7 bits each from the lowest, the
+ * last byte of a value flagged by the highest bit, read 8 bytes at once.
+ * lengths are not stored, they come from `offsets` ([#lists + 1], the first
+ * list at `in + 0`) which a graph keeps for degrees anyway.
+ *
+ * lists are found without decoding the ones before them by `skips`, the
+ * byte of every SKIP_INTERVAL-th list, and `seek`, which steps over at most
+ * SKIP_INTERVAL - 1 lists by their sizes
  */
-// |offsets| should be n_lists + 1
-static u32 encode(const u32 *__restrict const in,
-                  const u32 *__restrict const offsets,
-                  const u32 num_inner_lists, u8 *__restrict const out) {
-  u32 out_consumed = single::encode(offsets, num_inner_lists + 1u, out);
+namespace multiple {
+constexpr u32 SKIP_INTERVAL = 16u;
+
+static inline u64 align(const u64 pos) { return (pos + 31u) / 32u * 32u; }
+
+// values of the segment from the `begin`-th of a list of `length`
+static inline u32 segment(const u32 length, const u32 begin) {
+  return length - begin < SEGMENT ? length - begin : SEGMENT;
+}
+
+static inline u32 num_skips(const u32 num_inner_lists) {
+  return (num_inner_lists + SKIP_INTERVAL - 1u) / SKIP_INTERVAL;
+}
+
+static inline u32 varint_size(const u32 value) {
+  return value < (1u << 7u)
+             ? 1u
+             : value < (1u << 14u)
+                   ? 2u
+                   : value < (1u << 21u) ? 3u : value < (1u << 28u) ? 4u : 5u;
+}
+
+static inline u64 put_varint(u32 value, u8 *__restrict const out, u64 pos) {
+  while (value >= 0x80u) {
+    out[pos++] = static_cast<u8>(value & 0x7Fu);
+    value >>= 7u;
+  }
+  out[pos++] = static_cast<u8>(value | 0x80u);
+  return pos;
+}
 
-  u32 i = 0;
-  while (true) {
-    auto head = in + offsets[i];
-    u32 len = offsets[i + 1] - offsets[i];
-    if (len > THRESHOLD) {
-      // TODO
-      auto _head = head;
-      if ((reinterpret_cast<uintptr_t>(_head) & 15) != 0) {
-        const auto tmp = new a32_vector<u32>(head, head + len);
-        _head = tmp->data();
+/*
+ * encode
+ */
+// upper bound of the bytes of `encode`, with room for the last 8-byte read
+static inline u64 estimate(const u32 *__restrict const in,
+                           const u32 *__restrict const offsets,
+                           const u32 num_inner_lists) {
+  u64 pos = 0;
+  for (u32 i = 0; i < num_inner_lists; ++i) {
+    const auto list = in + (offsets[i] - offsets[0]);
+    const auto length = offsets[i + 1] - offsets[i];
+    if (length > THRESHOLD) {
+      for (u32 j = 0; j < length; j += SEGMENT) {
+        pos = align(pos) + single::estimate(list + j, segment(length, j));
       }
-      out_consumed += single::encode(_head, len, out + out_consumed);
-      i++;
     } else {
-      u32 len_acc = 0;
-      while (true) {
-        if ((len >= THRESHOLD && len_acc >= 256u) || i == num_inner_lists) {
-          break;
-        }
-        len = offsets[i + 1] - offsets[i];
-        len_acc += len;
-        i++;
+      for (u32 j = 0; j < length; ++j) {
+        pos += varint_size(j == 0 ? list[0] : list[j] - list[j - 1u]);
       }
-      {
-        // FIXME: consumed represents #remainBlocks of out
-        size_t consumed = len_acc;
-        // TODO
-        auto _head = head;
-        if ((reinterpret_cast<uintptr_t>(_head) & 15) != 0) {
-          const auto tmp = new a32_vector<u32>(head, head + len_acc);
-          _head = tmp->data();
-        }
-        pfor->encodeArray(_head, len_acc,
-                          reinterpret_cast<u32 *const>(out + out_consumed),
-                          consumed);
-        out_consumed += consumed * 4u;
-      }
-    }
-
-    out_consumed = ((out_consumed + 31u) / 32u) * 32u;
-    if (i == num_inner_lists) {
-      break;
     }
   }
-  return out_consumed;
+  return pos + sizeof(u64);
 }
 
-// |offsets| should be n_lists + 1
-static u32 estimate(const u32 *__restrict const in,
-                    const u32 *__restrict const offsets,
-                    const u32 num_inner_lists) {
-  u32 out_consumed = single::estimate(offsets, num_inner_lists + 1u);
-
-  u32 i = 0;
-  while (true) {
-    auto head = in + offsets[i];
-    u32 len = offsets[i + 1] - offsets[i];
-    if (len > THRESHOLD) {
-      out_consumed += single::estimate(head, len);
-      i++;
+// `out` is 32-byte aligned and zero-filled for `estimate` bytes, `skips`
+// of `num_skips` entries
+static inline u64 encode(const u32 *__restrict const in,
+                         const u32 *__restrict const offsets,
+                         const u32 num_inner_lists, u8 *__restrict const out,
+                         u64 *__restrict const skips) {
+  u64 pos = 0;
+  for (u32 i = 0; i < num_inner_lists; ++i) {
+    if (i % SKIP_INTERVAL == 0) {
+      skips[i / SKIP_INTERVAL] = pos;
+    }
+    const auto list = in + (offsets[i] - offsets[0]);
+    const auto length = offsets[i + 1] - offsets[i];
+    if (length > THRESHOLD) {
+      for (u32 j = 0; j < length; j += SEGMENT) {
+        pos = align(pos);
+        pos += single::encode(list + j, segment(length, j), out + pos);
+      }
     } else {
-      u32 len_acc = 0;
-      while (true) {
-        if ((len >= THRESHOLD && len_acc >= 256u) || i == num_inner_lists) {
-          break;
-        }
-        len = offsets[i + 1] - offsets[i];
-        len_acc += len;
-        i++;
+      for (u32 j = 0; j < length; ++j) {
+        pos = put_varint(j == 0 ? list[0] : list[j] - list[j - 1u], out, pos);
       }
-      { out_consumed += pfor->estimate(head, len_acc) * 4u; }
-    }
-
-    out_consumed = ((out_consumed + 31u) / 32u) * 32u;
-    if (i == num_inner_lists) {
-      break;
     }
   }
-
-  return out_consumed;
+  return pos;
 }
 
 /*
  * decode
  */
-static void decode(const u8 *const __restrict in, const u32 num_inner_lists,
-                   u32 *__restrict const out, u32 *__restrict const offsets) {
-  alignas(32) u32 buffer[100000] = {}; // TODO: must be unused
-  u32 in_consumed = single::decode(in, num_inner_lists + 1u, offsets);
-  in_consumed = ((in_consumed + 31u) / 32u) * 32u;
-  u32 out_consumed = 0;
-
-  u32 i = 0;
-  while (true) {
-    auto head = in + in_consumed;
-    u32 len = offsets[i + 1] - offsets[i];
-    if (len > THRESHOLD) {
-      in_consumed += single::decode(head, len, buffer);
-      std::copy(buffer, buffer + len, out + out_consumed);
-      out_consumed += len;
-      i++;
-    } else {
-      u32 len_acc = 0;
-      while (true) {
-        if ((len >= THRESHOLD && len_acc >= 256u) || i == num_inner_lists) {
-          break;
-        }
-        len = offsets[i + 1] - offsets[i];
-        len_acc += len;
-        i++;
-      }
-      {
-        size_t consumed = len_acc;
-        const auto proceeded = reinterpret_cast<const u8 *>(pfor->decodeArray(
-            reinterpret_cast<const u32 *const>(head), consumed /*dummy*/,
-            buffer, consumed /*as len_acc*/));
-        std::copy(buffer, buffer + len_acc, out + out_consumed);
-        in_consumed += proceeded - head;
-        out_consumed += len_acc;
-      }
+// visits the list of `length` values at byte `pos` as f(value), and returns
+// the byte of the next list. values are decoded while visited, so a walk
+// over lists in order needs no buffer for them
+template <class Func /*(value)*/>
+static inline u64 foreach_list(const u8 *__restrict const in, u64 pos,
+                               const u32 length, Func f) {
+  if (length > THRESHOLD) {
+    for (u32 j = 0; j < length; j += SEGMENT) {
+      pos = align(pos);
+      pos += single::foreach (in + pos, segment(length, j),
+                              [&f](const u32 value, const u32 local_idx) {
+                                f(value);
+                              });
     }
+    return pos;
+  }
+  u32 value = 0;
+  for (u32 j = 0; j < length; ++j) {
+    // bytes up to the first flagged one, gathered without branches
+    const auto word = load<u64>(in + pos);
+    const auto stops = word & 0x8080808080808080ull;
+    const auto bytes = word & (stops ^ (stops - 1u));
+    value += static_cast<u32>(
+        (bytes & 0x7Fu) | ((bytes >> 1u) & (0x7Fu << 7u)) |
+        ((bytes >> 2u) & (0x7Fu << 14u)) | ((bytes >> 3u) & (0x7Fu << 21u)) |
+        ((bytes >> 4u) & (0xFull << 28u)));
+    pos += (__builtin_ctzll(stops) >> 3u) + 1u;
+    f(value);
+  }
+  return pos;
+}
 
-    in_consumed = ((in_consumed + 31u) / 32u) * 32u;
-    if (i == num_inner_lists) {
-      break;
+// the byte of the list after the one of `length` values at byte `pos`, as
+// foreach_list returns. variable bytes are stepped over by counting the
+// flagged ones 8 bytes at once
+static inline u64 skip_list(const u8 *__restrict const in, u64 pos,
+                            const u32 length) {
+  if (length > THRESHOLD) {
+    for (u32 j = 0; j < length; j += SEGMENT) {
+      pos = align(pos);
+      pos += single::size(in + pos, segment(length, j));
+    }
+    return pos;
+  }
+  for (u32 remaining = length; remaining > 0;) {
+    auto stops = load<u64>(in + pos) & 0x8080808080808080ull;
+    const auto count = static_cast<u32>(__builtin_popcountll(stops));
+    if (count < remaining) {
+      pos += sizeof(u64);
+      remaining -= count;
+      continue;
+    }
+    for (; remaining > 1; --remaining) {
+      stops &= stops - 1u;
     }
+    return pos + (__builtin_ctzll(stops) >> 3u) + 1u;
   }
+  return pos;
 }
 
-template <
-    typename Func /*(unpacked_datum, local_offset, global_idx, local_idx)*/>
-static void foreach (const u8 *__restrict const in, const u32 num_inner_lists,
-                     Func f) {
-  a32_vector<u32> offsets((num_inner_lists + 1u + 31u) / 32u * 32u, 0); // TODO
-  u32 in_consumed = single::decode(in, num_inner_lists + 1, offsets.data());
-  in_consumed = ((in_consumed + 31u) / 32u) * 32u;
-
-  u32 i = 0;
-  while (true) {
-    auto head = in + in_consumed;
-    u32 len = offsets[i + 1] - offsets[i];
-    if (len > THRESHOLD) {
-      in_consumed +=
-          single::foreach (head, len,
-                           std::bind(f, std::placeholders::_1, offsets[i], i,
-                                     std::placeholders::_2));
-      i++;
-    } else {
-      u32 acc_start = i;
-      u32 len_acc = 0;
-      while (true) {
-        if ((len >= THRESHOLD && len_acc >= 256u) || i == num_inner_lists) {
-          break;
-        }
-        len = offsets[i + 1] - offsets[i];
-        len_acc += len;
-        i++;
-      }
-      {
-        size_t consumed = len_acc;
-        u32 k = 0;
-
-        // FIXME
-        const auto proceeded = reinterpret_cast<const u8 *__restrict>(
-            pfor->mapArray(reinterpret_cast<const u32 *__restrict const>(head),
-                           consumed /*dummy*/, consumed /*as len_acc*/, f,
-                           offsets.data(), acc_start, i, k));
-
-        in_consumed += proceeded - head;
-      }
-    }
+// the byte of the `idx`-th list, from the nearest skip before it
+static inline u64 seek(const u8 *__restrict const in,
+                       const u32 *__restrict const offsets,
+                       const u64 *__restrict const skips, const u32 idx) {
+  auto pos = skips[idx / SKIP_INTERVAL];
+  for (u32 i = idx / SKIP_INTERVAL * SKIP_INTERVAL; i < idx; ++i) {
+    pos = skip_list(in, pos, offsets[i + 1] - offsets[i]);
+  }
+  return pos;
+}
 
-    in_consumed = ((in_consumed + 31u) / 32u) * 32u;
-    if (i == num_inner_lists) {
-      break;
-    }
+template <class Func /*(value, list_idx, local_idx)*/>
+static inline void foreach (const u8 *__restrict const in,
+                            const u32 *__restrict const offsets,
+                            const u32 num_inner_lists, Func f) {
+  u64 pos = 0;
+  for (u32 i = 0; i < num_inner_lists; ++i) {
+    u32 local_idx = 0;
+    pos = foreach_list(in, pos, offsets[i + 1] - offsets[i],
+                       [&](const u32 value) { f(value, i, local_idx++); });
   }
 }
-} // namespace hoshizora::compress::multiple
-#endif // MULTIPLE_H
+
+// `out` of offsets[num_inner_lists] - offsets[0] values
+static inline void decode(const u8 *__restrict const in,
+                          const u32 *__restrict const offsets,
+                          const u32 num_inner_lists,
+                          u32 *__restrict const out) {
+  foreach (in, offsets, num_inner_lists,
+           [&](const u32 value, const u32 list_idx, const u32 local_idx) {
+             out[offsets[list_idx] - offsets[0] + local_idx] = value;
+           });
+}
+} // namespace multiple
+} // namespace compress
+} // namespace hoshizora
+#endif // HOSHIZORA_COMPRESS_MULTIPLE_H
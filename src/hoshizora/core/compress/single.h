@@ -1,20 +1,31 @@
-#ifndef SINGLE_H
-#define SINGLE_H
+#ifndef HOSHIZORA_COMPRESS_SINGLE_H
+#define HOSHIZORA_COMPRESS_SINGLE_H
 
-#include <chrono>
 #include <immintrin.h>
-#include <iostream>
-#include <string>
 
 #include "hoshizora/core/compress/common.h"
-#include "hoshizora/core/util/includes.h"
+#include "hoshizora/core/includes.h"
 
-namespace hoshizora::compress::single {
+namespace hoshizora {
+namespace compress {
+/*
+ * a sorted list of u32, from a 32-byte boundary:
+ * [4-bit flags of blocks, padded to 32 bytes]
+ * [blocks of 8 values each minus the last value of the previous block,
+ *  bitpacked lane by lane into 256-bit words by the widths of the flags]
+ * [remaining < 8 values as u16/u32 deltas after a byte of their widths]
+ * and padded to 32 bytes. encode returns the bytes written, decode, foreach
+ * and size the bytes read. lists are of at most SEGMENT values
+ */
+namespace single {
+// flags of the blocks of a list, and one more for an odd number of them
+constexpr u32 FLAGS_BYTE = SEGMENT / LENGTH + YMM_BYTE;
 /*
  * encode
  */
-static u32 encode(const u32 *__restrict const in, const u32 length,
-                  u8 *__restrict const out) {
+static inline u32 encode(const u32 *__restrict const in, const u32 length,
+                         u8 *__restrict const out) {
+  assert(length <= SEGMENT);
   if (length == 0) {
     return 0;
   }
@@ -27,7 +38,8 @@ static u32 encode(const u32 *__restrict const in, const u32 length,
     const u32 n_flag_blocks_align32 = ((n_flag_blocks + 31u) / 32u) * 32u;
     out_offset += n_flag_blocks_align32;
 
-    a32_vector<u8> flags(n_blocks + 1u, 0); // TODO: w/o vector
+    alignas(32) u8 flags[FLAGS_BYTE];
+    flags[n_blocks] = 0;
 
     u8 n_used_bits = 0;
     auto prev = _mm256_setzero_si256();
@@ -71,9 +83,9 @@ static u32 encode(const u32 *__restrict const in, const u32 length,
     for (u32 i = 0; i < N; i++) {
       const auto acc = _mm256_or_si256(
           _mm256_load_si256(
-              reinterpret_cast<__m256icpc>(flags.data() + YMM_BYTE * (i * 2u))),
+              reinterpret_cast<__m256icpc>(flags + YMM_BYTE * (i * 2u))),
           _mm256_slli_epi8(_mm256_load_si256(reinterpret_cast<__m256icpc>(
-                               flags.data() + YMM_BYTE * (i * 2u + 1))),
+                               flags + YMM_BYTE * (i * 2u + 1))),
                            4u));
       _mm256_store_si256(reinterpret_cast<__m256ipc>(out + YMM_BYTE * i), acc);
     }
@@ -92,11 +104,10 @@ static u32 encode(const u32 *__restrict const in, const u32 length,
     // length < 8
     if (in_offset == 0) {
       if (in[0] <= 0xFFFFu) {
-        reinterpret_cast<u16 *const>(out + out_offset)[0] =
-            static_cast<u16>(in[0]);
+        store<u16>(out + out_offset, static_cast<u16>(in[0]));
         out_offset += 2u;
       } else {
-        reinterpret_cast<u32 *const>(out + out_offset)[0] = in[0];
+        store<u32>(out + out_offset, in[0]);
         out_offset += 4u;
         // nibble from lower bit
         out[flag_idx] = 0b00000001u;
@@ -107,11 +118,10 @@ static u32 encode(const u32 *__restrict const in, const u32 length,
     for (; in_offset < length; in_offset++) {
       const u32 diff = in[in_offset] - in[in_offset - 1u];
       if (diff <= 0xFFFFu) {
-        reinterpret_cast<u16 *const>(out + out_offset)[0] =
-            static_cast<u16>(diff);
+        store<u16>(out + out_offset, static_cast<u16>(diff));
         out_offset += 2u;
       } else {
-        reinterpret_cast<u32 *const>(out + out_offset)[0] = diff;
+        store<u32>(out + out_offset, diff);
         out_offset += 4u;
         // nibble from lower bit
         out[flag_idx] |= 0b00000001u << (remain - (length - in_offset));
@@ -125,7 +135,7 @@ static u32 encode(const u32 *__restrict const in, const u32 length,
   return (out_offset + 31u) / 32u * 32u;
 }
 
-static u32 estimate(const u32 *__restrict const in, const u32 length) {
+static inline u32 estimate(const u32 *__restrict const in, const u32 length) {
   if (length == 0) {
     return 0;
   }
@@ -195,6 +205,57 @@ static u32 estimate(const u32 *__restrict const in, const u32 length) {
   return (out_offset + 31u) / 32u * 32u;
 }
 
+/*
+ * bytes of an encoded list of `length` values, as decode returns, from the
+ * flags alone: boxes are replayed by the pack sizes and nothing is unpacked
+ */
+static inline u32 size(const u8 *__restrict const in, const u32 length) {
+  if (length == 0) {
+    return 0;
+  }
+
+  u32 in_offset = 0;
+  const u32 n_blocks = length / LENGTH;
+  if (n_blocks) {
+    const u32 n_flag_blocks = (n_blocks + 1u) / 2u;
+    const u32 n_flag_blocks_align32 = ((n_flag_blocks + 31u) / 32u) * 32u;
+    in_offset += n_flag_blocks_align32;
+
+    // a full 32 bytes of flags holds 64 blocks, the i-th and (i+32)-th in
+    // the lower and upper nibbles of byte i. the rest are paired in order
+    const u32 N = n_flag_blocks / YMM_BYTE;
+    u8 n_used_bits = 0u;
+    for (u32 i = 0; i < n_blocks; i++) {
+      const u32 group = i / (YMM_BYTE * 2u);
+      const u8 flag =
+          group < N ? in[YMM_BYTE * group + i % YMM_BYTE] >>
+                          (i % (YMM_BYTE * 2u) < YMM_BYTE ? 0u : 4u)
+                    : in[i / 2u] >> (i % 2u == 0 ? 0u : 4u);
+      const u32 pack_size = pack_sizes[flag & 0xFu];
+
+      if (n_used_bits + pack_size > BIT_PER_BOX) {
+        in_offset += YMM_BYTE;
+        n_used_bits = static_cast<u8>(pack_size);
+      } else {
+        n_used_bits += pack_size;
+      }
+    }
+
+    if (n_used_bits > 0u) {
+      in_offset += YMM_BYTE;
+    }
+  }
+
+  const u32 remain = length - n_blocks * LENGTH;
+  if (remain > 0u) {
+    // u16 deltas, u32 ones flagged, and the padding for overrun as encode
+    const u32 n_wide = static_cast<u32>(__builtin_popcount(in[in_offset]));
+    in_offset += 1u + (remain + n_wide) * 2u + (8u - remain) * 2u;
+  }
+
+  return (in_offset + 31u) / 32u * 32u;
+}
+
 /*
  * decode
  */
@@ -210,184 +271,186 @@ static inline u8 ungap(const u8 *__restrict const in, const u32 prev,
   constexpr u8 o6 = o5 + (f5 ? 4 : 2);
   constexpr u8 total = o6 + (f6 ? 4 : 2);
 
-  if constexpr (f0) {
-    out[0] = prev + reinterpret_cast<const u32 *const>(in)[0];
+  if (f0) {
+    out[0] = prev + load<u32>(in);
   } else {
-    out[0] = prev + reinterpret_cast<const u16 *const>(in)[0];
+    out[0] = prev + load<u16>(in);
   }
 
-  if constexpr (f1) {
-    out[1] = out[0] + reinterpret_cast<const u32 *const>(in + o1)[0];
+  if (f1) {
+    out[1] = out[0] + load<u32>(in + o1);
   } else {
-    out[1] = out[0] + reinterpret_cast<const u16 *const>(in + o1)[0];
+    out[1] = out[0] + load<u16>(in + o1);
   }
 
-  if constexpr (f2) {
-    out[2] = out[1] + reinterpret_cast<const u32 *const>(in + o2)[0];
+  if (f2) {
+    out[2] = out[1] + load<u32>(in + o2);
   } else {
-    out[2] = out[1] + reinterpret_cast<const u16 *const>(in + o2)[0];
+    out[2] = out[1] + load<u16>(in + o2);
   }
 
-  if constexpr (f3) {
-    out[3] = out[2] + reinterpret_cast<const u32 *const>(in + o3)[0];
+  if (f3) {
+    out[3] = out[2] + load<u32>(in + o3);
   } else {
-    out[3] = out[2] + reinterpret_cast<const u16 *const>(in + o3)[0];
+    out[3] = out[2] + load<u16>(in + o3);
   }
 
-  if constexpr (f4) {
-    out[4] = out[3] + reinterpret_cast<const u32 *const>(in + o4)[0];
+  if (f4) {
+    out[4] = out[3] + load<u32>(in + o4);
   } else {
-    out[4] = out[3] + reinterpret_cast<const u16 *const>(in + o4)[0];
+    out[4] = out[3] + load<u16>(in + o4);
   }
 
-  if constexpr (f5) {
-    out[5] = out[4] + reinterpret_cast<const u32 *const>(in + o5)[0];
+  if (f5) {
+    out[5] = out[4] + load<u32>(in + o5);
   } else {
-    out[5] = out[4] + reinterpret_cast<const u16 *const>(in + o5)[0];
+    out[5] = out[4] + load<u16>(in + o5);
   }
 
-  if constexpr (f6) {
-    out[6] = out[5] + reinterpret_cast<const u32 *const>(in + o6)[0];
+  if (f6) {
+    out[6] = out[5] + load<u32>(in + o6);
   } else {
-    out[6] = out[5] + reinterpret_cast<const u16 *const>(in + o6)[0];
+    out[6] = out[5] + load<u16>(in + o6);
   }
 
   return total;
 }
 
-const static function<u8(const u8 *__restrict const, const u32,
-                         u32 *__restrict const)>
-    ungaps[256] = {ungap<0, 0, 0, 0, 0, 0, 0>, ungap<1, 0, 0, 0, 0, 0, 0>,
-                   ungap<0, 1, 0, 0, 0, 0, 0>, ungap<1, 1, 0, 0, 0, 0, 0>,
-                   ungap<0, 0, 1, 0, 0, 0, 0>, ungap<1, 0, 1, 0, 0, 0, 0>,
-                   ungap<0, 1, 1, 0, 0, 0, 0>, ungap<1, 1, 1, 0, 0, 0, 0>,
-                   ungap<0, 0, 0, 1, 0, 0, 0>, ungap<1, 0, 0, 1, 0, 0, 0>,
-                   ungap<0, 1, 0, 1, 0, 0, 0>, ungap<1, 1, 0, 1, 0, 0, 0>,
-                   ungap<0, 0, 1, 1, 0, 0, 0>, ungap<1, 0, 1, 1, 0, 0, 0>,
-                   ungap<0, 1, 1, 1, 0, 0, 0>, ungap<1, 1, 1, 1, 0, 0, 0>,
-                   ungap<0, 0, 0, 0, 1, 0, 0>, ungap<1, 0, 0, 0, 1, 0, 0>,
-                   ungap<0, 1, 0, 0, 1, 0, 0>, ungap<1, 1, 0, 0, 1, 0, 0>,
-                   ungap<0, 0, 1, 0, 1, 0, 0>, ungap<1, 0, 1, 0, 1, 0, 0>,
-                   ungap<0, 1, 1, 0, 1, 0, 0>, ungap<1, 1, 1, 0, 1, 0, 0>,
-                   ungap<0, 0, 0, 1, 1, 0, 0>, ungap<1, 0, 0, 1, 1, 0, 0>,
-                   ungap<0, 1, 0, 1, 1, 0, 0>, ungap<1, 1, 0, 1, 1, 0, 0>,
-                   ungap<0, 0, 1, 1, 1, 0, 0>, ungap<1, 0, 1, 1, 1, 0, 0>,
-                   ungap<0, 1, 1, 1, 1, 0, 0>, ungap<1, 1, 1, 1, 1, 0, 0>,
-                   ungap<0, 0, 0, 0, 0, 1, 0>, ungap<1, 0, 0, 0, 0, 1, 0>,
-                   ungap<0, 1, 0, 0, 0, 1, 0>, ungap<1, 1, 0, 0, 0, 1, 0>,
-                   ungap<0, 0, 1, 0, 0, 1, 0>, ungap<1, 0, 1, 0, 0, 1, 0>,
-                   ungap<0, 1, 1, 0, 0, 1, 0>, ungap<1, 1, 1, 0, 0, 1, 0>,
-                   ungap<0, 0, 0, 1, 0, 1, 0>, ungap<1, 0, 0, 1, 0, 1, 0>,
-                   ungap<0, 1, 0, 1, 0, 1, 0>, ungap<1, 1, 0, 1, 0, 1, 0>,
-                   ungap<0, 0, 1, 1, 0, 1, 0>, ungap<1, 0, 1, 1, 0, 1, 0>,
-                   ungap<0, 1, 1, 1, 0, 1, 0>, ungap<1, 1, 1, 1, 0, 1, 0>,
-                   ungap<0, 0, 0, 0, 1, 1, 0>, ungap<1, 0, 0, 0, 1, 1, 0>,
-                   ungap<0, 1, 0, 0, 1, 1, 0>, ungap<1, 1, 0, 0, 1, 1, 0>,
-                   ungap<0, 0, 1, 0, 1, 1, 0>, ungap<1, 0, 1, 0, 1, 1, 0>,
-                   ungap<0, 1, 1, 0, 1, 1, 0>, ungap<1, 1, 1, 0, 1, 1, 0>,
-                   ungap<0, 0, 0, 1, 1, 1, 0>, ungap<1, 0, 0, 1, 1, 1, 0>,
-                   ungap<0, 1, 0, 1, 1, 1, 0>, ungap<1, 1, 0, 1, 1, 1, 0>,
-                   ungap<0, 0, 1, 1, 1, 1, 0>, ungap<1, 0, 1, 1, 1, 1, 0>,
-                   ungap<0, 1, 1, 1, 1, 1, 0>, ungap<1, 1, 1, 1, 1, 1, 0>,
-                   ungap<0, 0, 0, 0, 0, 0, 1>, ungap<1, 0, 0, 0, 0, 0, 1>,
-                   ungap<0, 1, 0, 0, 0, 0, 1>, ungap<1, 1, 0, 0, 0, 0, 1>,
-                   ungap<0, 0, 1, 0, 0, 0, 1>, ungap<1, 0, 1, 0, 0, 0, 1>,
-                   ungap<0, 1, 1, 0, 0, 0, 1>, ungap<1, 1, 1, 0, 0, 0, 1>,
-                   ungap<0, 0, 0, 1, 0, 0, 1>, ungap<1, 0, 0, 1, 0, 0, 1>,
-                   ungap<0, 1, 0, 1, 0, 0, 1>, ungap<1, 1, 0, 1, 0, 0, 1>,
-                   ungap<0, 0, 1, 1, 0, 0, 1>, ungap<1, 0, 1, 1, 0, 0, 1>,
-                   ungap<0, 1, 1, 1, 0, 0, 1>, ungap<1, 1, 1, 1, 0, 0, 1>,
-                   ungap<0, 0, 0, 0, 1, 0, 1>, ungap<1, 0, 0, 0, 1, 0, 1>,
-                   ungap<0, 1, 0, 0, 1, 0, 1>, ungap<1, 1, 0, 0, 1, 0, 1>,
-                   ungap<0, 0, 1, 0, 1, 0, 1>, ungap<1, 0, 1, 0, 1, 0, 1>,
-                   ungap<0, 1, 1, 0, 1, 0, 1>, ungap<1, 1, 1, 0, 1, 0, 1>,
-                   ungap<0, 0, 0, 1, 1, 0, 1>, ungap<1, 0, 0, 1, 1, 0, 1>,
-                   ungap<0, 1, 0, 1, 1, 0, 1>, ungap<1, 1, 0, 1, 1, 0, 1>,
-                   ungap<0, 0, 1, 1, 1, 0, 1>, ungap<1, 0, 1, 1, 1, 0, 1>,
-                   ungap<0, 1, 1, 1, 1, 0, 1>, ungap<1, 1, 1, 1, 1, 0, 1>,
-                   ungap<0, 0, 0, 0, 0, 1, 1>, ungap<1, 0, 0, 0, 0, 1, 1>,
-                   ungap<0, 1, 0, 0, 0, 1, 1>, ungap<1, 1, 0, 0, 0, 1, 1>,
-                   ungap<0, 0, 1, 0, 0, 1, 1>, ungap<1, 0, 1, 0, 0, 1, 1>,
-                   ungap<0, 1, 1, 0, 0, 1, 1>, ungap<1, 1, 1, 0, 0, 1, 1>,
-                   ungap<0, 0, 0, 1, 0, 1, 1>, ungap<1, 0, 0, 1, 0, 1, 1>,
-                   ungap<0, 1, 0, 1, 0, 1, 1>, ungap<1, 1, 0, 1, 0, 1, 1>,
-                   ungap<0, 0, 1, 1, 0, 1, 1>, ungap<1, 0, 1, 1, 0, 1, 1>,
-                   ungap<0, 1, 1, 1, 0, 1, 1>, ungap<1, 1, 1, 1, 0, 1, 1>,
-                   ungap<0, 0, 0, 0, 1, 1, 1>, ungap<1, 0, 0, 0, 1, 1, 1>,
-                   ungap<0, 1, 0, 0, 1, 1, 1>, ungap<1, 1, 0, 0, 1, 1, 1>,
-                   ungap<0, 0, 1, 0, 1, 1, 1>, ungap<1, 0, 1, 0, 1, 1, 1>,
-                   ungap<0, 1, 1, 0, 1, 1, 1>, ungap<1, 1, 1, 0, 1, 1, 1>,
-                   ungap<0, 0, 0, 1, 1, 1, 1>, ungap<1, 0, 0, 1, 1, 1, 1>,
-                   ungap<0, 1, 0, 1, 1, 1, 1>, ungap<1, 1, 0, 1, 1, 1, 1>,
-                   ungap<0, 0, 1, 1, 1, 1, 1>, ungap<1, 0, 1, 1, 1, 1, 1>,
-                   ungap<0, 1, 1, 1, 1, 1, 1>, ungap<1, 1, 1, 1, 1, 1, 1>,
-                   ungap<0, 0, 0, 0, 0, 0, 0>, ungap<1, 0, 0, 0, 0, 0, 0>,
-                   ungap<0, 1, 0, 0, 0, 0, 0>, ungap<1, 1, 0, 0, 0, 0, 0>,
-                   ungap<0, 0, 1, 0, 0, 0, 0>, ungap<1, 0, 1, 0, 0, 0, 0>,
-                   ungap<0, 1, 1, 0, 0, 0, 0>, ungap<1, 1, 1, 0, 0, 0, 0>,
-                   ungap<0, 0, 0, 1, 0, 0, 0>, ungap<1, 0, 0, 1, 0, 0, 0>,
-                   ungap<0, 1, 0, 1, 0, 0, 0>, ungap<1, 1, 0, 1, 0, 0, 0>,
-                   ungap<0, 0, 1, 1, 0, 0, 0>, ungap<1, 0, 1, 1, 0, 0, 0>,
-                   ungap<0, 1, 1, 1, 0, 0, 0>, ungap<1, 1, 1, 1, 0, 0, 0>,
-                   ungap<0, 0, 0, 0, 1, 0, 0>, ungap<1, 0, 0, 0, 1, 0, 0>,
-                   ungap<0, 1, 0, 0, 1, 0, 0>, ungap<1, 1, 0, 0, 1, 0, 0>,
-                   ungap<0, 0, 1, 0, 1, 0, 0>, ungap<1, 0, 1, 0, 1, 0, 0>,
-                   ungap<0, 1, 1, 0, 1, 0, 0>, ungap<1, 1, 1, 0, 1, 0, 0>,
-                   ungap<0, 0, 0, 1, 1, 0, 0>, ungap<1, 0, 0, 1, 1, 0, 0>,
-                   ungap<0, 1, 0, 1, 1, 0, 0>, ungap<1, 1, 0, 1, 1, 0, 0>,
-                   ungap<0, 0, 1, 1, 1, 0, 0>, ungap<1, 0, 1, 1, 1, 0, 0>,
-                   ungap<0, 1, 1, 1, 1, 0, 0>, ungap<1, 1, 1, 1, 1, 0, 0>,
-                   ungap<0, 0, 0, 0, 0, 1, 0>, ungap<1, 0, 0, 0, 0, 1, 0>,
-                   ungap<0, 1, 0, 0, 0, 1, 0>, ungap<1, 1, 0, 0, 0, 1, 0>,
-                   ungap<0, 0, 1, 0, 0, 1, 0>, ungap<1, 0, 1, 0, 0, 1, 0>,
-                   ungap<0, 1, 1, 0, 0, 1, 0>, ungap<1, 1, 1, 0, 0, 1, 0>,
-                   ungap<0, 0, 0, 1, 0, 1, 0>, ungap<1, 0, 0, 1, 0, 1, 0>,
-                   ungap<0, 1, 0, 1, 0, 1, 0>, ungap<1, 1, 0, 1, 0, 1, 0>,
-                   ungap<0, 0, 1, 1, 0, 1, 0>, ungap<1, 0, 1, 1, 0, 1, 0>,
-                   ungap<0, 1, 1, 1, 0, 1, 0>, ungap<1, 1, 1, 1, 0, 1, 0>,
-                   ungap<0, 0, 0, 0, 1, 1, 0>, ungap<1, 0, 0, 0, 1, 1, 0>,
-                   ungap<0, 1, 0, 0, 1, 1, 0>, ungap<1, 1, 0, 0, 1, 1, 0>,
-                   ungap<0, 0, 1, 0, 1, 1, 0>, ungap<1, 0, 1, 0, 1, 1, 0>,
-                   ungap<0, 1, 1, 0, 1, 1, 0>, ungap<1, 1, 1, 0, 1, 1, 0>,
-                   ungap<0, 0, 0, 1, 1, 1, 0>, ungap<1, 0, 0, 1, 1, 1, 0>,
-                   ungap<0, 1, 0, 1, 1, 1, 0>, ungap<1, 1, 0, 1, 1, 1, 0>,
-                   ungap<0, 0, 1, 1, 1, 1, 0>, ungap<1, 0, 1, 1, 1, 1, 0>,
-                   ungap<0, 1, 1, 1, 1, 1, 0>, ungap<1, 1, 1, 1, 1, 1, 0>,
-                   ungap<0, 0, 0, 0, 0, 0, 1>, ungap<1, 0, 0, 0, 0, 0, 1>,
-                   ungap<0, 1, 0, 0, 0, 0, 1>, ungap<1, 1, 0, 0, 0, 0, 1>,
-                   ungap<0, 0, 1, 0, 0, 0, 1>, ungap<1, 0, 1, 0, 0, 0, 1>,
-                   ungap<0, 1, 1, 0, 0, 0, 1>, ungap<1, 1, 1, 0, 0, 0, 1>,
-                   ungap<0, 0, 0, 1, 0, 0, 1>, ungap<1, 0, 0, 1, 0, 0, 1>,
-                   ungap<0, 1, 0, 1, 0, 0, 1>, ungap<1, 1, 0, 1, 0, 0, 1>,
-                   ungap<0, 0, 1, 1, 0, 0, 1>, ungap<1, 0, 1, 1, 0, 0, 1>,
-                   ungap<0, 1, 1, 1, 0, 0, 1>, ungap<1, 1, 1, 1, 0, 0, 1>,
-                   ungap<0, 0, 0, 0, 1, 0, 1>, ungap<1, 0, 0, 0, 1, 0, 1>,
-                   ungap<0, 1, 0, 0, 1, 0, 1>, ungap<1, 1, 0, 0, 1, 0, 1>,
-                   ungap<0, 0, 1, 0, 1, 0, 1>, ungap<1, 0, 1, 0, 1, 0, 1>,
-                   ungap<0, 1, 1, 0, 1, 0, 1>, ungap<1, 1, 1, 0, 1, 0, 1>,
-                   ungap<0, 0, 0, 1, 1, 0, 1>, ungap<1, 0, 0, 1, 1, 0, 1>,
-                   ungap<0, 1, 0, 1, 1, 0, 1>, ungap<1, 1, 0, 1, 1, 0, 1>,
-                   ungap<0, 0, 1, 1, 1, 0, 1>, ungap<1, 0, 1, 1, 1, 0, 1>,
-                   ungap<0, 1, 1, 1, 1, 0, 1>, ungap<1, 1, 1, 1, 1, 0, 1>,
-                   ungap<0, 0, 0, 0, 0, 1, 1>, ungap<1, 0, 0, 0, 0, 1, 1>,
-                   ungap<0, 1, 0, 0, 0, 1, 1>, ungap<1, 1, 0, 0, 0, 1, 1>,
-                   ungap<0, 0, 1, 0, 0, 1, 1>, ungap<1, 0, 1, 0, 0, 1, 1>,
-                   ungap<0, 1, 1, 0, 0, 1, 1>, ungap<1, 1, 1, 0, 0, 1, 1>,
-                   ungap<0, 0, 0, 1, 0, 1, 1>, ungap<1, 0, 0, 1, 0, 1, 1>,
-                   ungap<0, 1, 0, 1, 0, 1, 1>, ungap<1, 1, 0, 1, 0, 1, 1>,
-                   ungap<0, 0, 1, 1, 0, 1, 1>, ungap<1, 0, 1, 1, 0, 1, 1>,
-                   ungap<0, 1, 1, 1, 0, 1, 1>, ungap<1, 1, 1, 1, 0, 1, 1>,
-                   ungap<0, 0, 0, 0, 1, 1, 1>, ungap<1, 0, 0, 0, 1, 1, 1>,
-                   ungap<0, 1, 0, 0, 1, 1, 1>, ungap<1, 1, 0, 0, 1, 1, 1>,
-                   ungap<0, 0, 1, 0, 1, 1, 1>, ungap<1, 0, 1, 0, 1, 1, 1>,
-                   ungap<0, 1, 1, 0, 1, 1, 1>, ungap<1, 1, 1, 0, 1, 1, 1>,
-                   ungap<0, 0, 0, 1, 1, 1, 1>, ungap<1, 0, 0, 1, 1, 1, 1>,
-                   ungap<0, 1, 0, 1, 1, 1, 1>, ungap<1, 1, 0, 1, 1, 1, 1>,
-                   ungap<0, 0, 1, 1, 1, 1, 1>, ungap<1, 0, 1, 1, 1, 1, 1>,
-                   ungap<0, 1, 1, 1, 1, 1, 1>, ungap<1, 1, 1, 1, 1, 1, 1>};
-
-static u32 decode(const u8 *__restrict const in, const u32 length,
-                  u32 *__restrict const out) {
+using Ungap = u8 (*)(const u8 *__restrict const, const u32,
+                   u32 *__restrict const);
+const static Ungap ungaps[256] = {
+    ungap<0, 0, 0, 0, 0, 0, 0>, ungap<1, 0, 0, 0, 0, 0, 0>,
+    ungap<0, 1, 0, 0, 0, 0, 0>, ungap<1, 1, 0, 0, 0, 0, 0>,
+    ungap<0, 0, 1, 0, 0, 0, 0>, ungap<1, 0, 1, 0, 0, 0, 0>,
+    ungap<0, 1, 1, 0, 0, 0, 0>, ungap<1, 1, 1, 0, 0, 0, 0>,
+    ungap<0, 0, 0, 1, 0, 0, 0>, ungap<1, 0, 0, 1, 0, 0, 0>,
+    ungap<0, 1, 0, 1, 0, 0, 0>, ungap<1, 1, 0, 1, 0, 0, 0>,
+    ungap<0, 0, 1, 1, 0, 0, 0>, ungap<1, 0, 1, 1, 0, 0, 0>,
+    ungap<0, 1, 1, 1, 0, 0, 0>, ungap<1, 1, 1, 1, 0, 0, 0>,
+    ungap<0, 0, 0, 0, 1, 0, 0>, ungap<1, 0, 0, 0, 1, 0, 0>,
+    ungap<0, 1, 0, 0, 1, 0, 0>, ungap<1, 1, 0, 0, 1, 0, 0>,
+    ungap<0, 0, 1, 0, 1, 0, 0>, ungap<1, 0, 1, 0, 1, 0, 0>,
+    ungap<0, 1, 1, 0, 1, 0, 0>, ungap<1, 1, 1, 0, 1, 0, 0>,
+    ungap<0, 0, 0, 1, 1, 0, 0>, ungap<1, 0, 0, 1, 1, 0, 0>,
+    ungap<0, 1, 0, 1, 1, 0, 0>, ungap<1, 1, 0, 1, 1, 0, 0>,
+    ungap<0, 0, 1, 1, 1, 0, 0>, ungap<1, 0, 1, 1, 1, 0, 0>,
+    ungap<0, 1, 1, 1, 1, 0, 0>, ungap<1, 1, 1, 1, 1, 0, 0>,
+    ungap<0, 0, 0, 0, 0, 1, 0>, ungap<1, 0, 0, 0, 0, 1, 0>,
+    ungap<0, 1, 0, 0, 0, 1, 0>, ungap<1, 1, 0, 0, 0, 1, 0>,
+    ungap<0, 0, 1, 0, 0, 1, 0>, ungap<1, 0, 1, 0, 0, 1, 0>,
+    ungap<0, 1, 1, 0, 0, 1, 0>, ungap<1, 1, 1, 0, 0, 1, 0>,
+    ungap<0, 0, 0, 1, 0, 1, 0>, ungap<1, 0, 0, 1, 0, 1, 0>,
+    ungap<0, 1, 0, 1, 0, 1, 0>, ungap<1, 1, 0, 1, 0, 1, 0>,
+    ungap<0, 0, 1, 1, 0, 1, 0>, ungap<1, 0, 1, 1, 0, 1, 0>,
+    ungap<0, 1, 1, 1, 0, 1, 0>, ungap<1, 1, 1, 1, 0, 1, 0>,
+    ungap<0, 0, 0, 0, 1, 1, 0>, ungap<1, 0, 0, 0, 1, 1, 0>,
+    ungap<0, 1, 0, 0, 1, 1, 0>, ungap<1, 1, 0, 0, 1, 1, 0>,
+    ungap<0, 0, 1, 0, 1, 1, 0>, ungap<1, 0, 1, 0, 1, 1, 0>,
+    ungap<0, 1, 1, 0, 1, 1, 0>, ungap<1, 1, 1, 0, 1, 1, 0>,
+    ungap<0, 0, 0, 1, 1, 1, 0>, ungap<1, 0, 0, 1, 1, 1, 0>,
+    ungap<0, 1, 0, 1, 1, 1, 0>, ungap<1, 1, 0, 1, 1, 1, 0>,
+    ungap<0, 0, 1, 1, 1, 1, 0>, ungap<1, 0, 1, 1, 1, 1, 0>,
+    ungap<0, 1, 1, 1, 1, 1, 0>, ungap<1, 1, 1, 1, 1, 1, 0>,
+    ungap<0, 0, 0, 0, 0, 0, 1>, ungap<1, 0, 0, 0, 0, 0, 1>,
+    ungap<0, 1, 0, 0, 0, 0, 1>, ungap<1, 1, 0, 0, 0, 0, 1>,
+    ungap<0, 0, 1, 0, 0, 0, 1>, ungap<1, 0, 1, 0, 0, 0, 1>,
+    ungap<0, 1, 1, 0, 0, 0, 1>, ungap<1, 1, 1, 0, 0, 0, 1>,
+    ungap<0, 0, 0, 1, 0, 0, 1>, ungap<1, 0, 0, 1, 0, 0, 1>,
+    ungap<0, 1, 0, 1, 0, 0, 1>, ungap<1, 1, 0, 1, 0, 0, 1>,
+    ungap<0, 0, 1, 1, 0, 0, 1>, ungap<1, 0, 1, 1, 0, 0, 1>,
+    ungap<0, 1, 1, 1, 0, 0, 1>, ungap<1, 1, 1, 1, 0, 0, 1>,
+    ungap<0, 0, 0, 0, 1, 0, 1>, ungap<1, 0, 0, 0, 1, 0, 1>,
+    ungap<0, 1, 0, 0, 1, 0, 1>, ungap<1, 1, 0, 0, 1, 0, 1>,
+    ungap<0, 0, 1, 0, 1, 0, 1>, ungap<1, 0, 1, 0, 1, 0, 1>,
+    ungap<0, 1, 1, 0, 1, 0, 1>, ungap<1, 1, 1, 0, 1, 0, 1>,
+    ungap<0, 0, 0, 1, 1, 0, 1>, ungap<1, 0, 0, 1, 1, 0, 1>,
+    ungap<0, 1, 0, 1, 1, 0, 1>, ungap<1, 1, 0, 1, 1, 0, 1>,
+    ungap<0, 0, 1, 1, 1, 0, 1>, ungap<1, 0, 1, 1, 1, 0, 1>,
+    ungap<0, 1, 1, 1, 1, 0, 1>, ungap<1, 1, 1, 1, 1, 0, 1>,
+    ungap<0, 0, 0, 0, 0, 1, 1>, ungap<1, 0, 0, 0, 0, 1, 1>,
+    ungap<0, 1, 0, 0, 0, 1, 1>, ungap<1, 1, 0, 0, 0, 1, 1>,
+    ungap<0, 0, 1, 0, 0, 1, 1>, ungap<1, 0, 1, 0, 0, 1, 1>,
+    ungap<0, 1, 1, 0, 0, 1, 1>, ungap<1, 1, 1, 0, 0, 1, 1>,
+    ungap<0, 0, 0, 1, 0, 1, 1>, ungap<1, 0, 0, 1, 0, 1, 1>,
+    ungap<0, 1, 0, 1, 0, 1, 1>, ungap<1, 1, 0, 1, 0, 1, 1>,
+    ungap<0, 0, 1, 1, 0, 1, 1>, ungap<1, 0, 1, 1, 0, 1, 1>,
+    ungap<0, 1, 1, 1, 0, 1, 1>, ungap<1, 1, 1, 1, 0, 1, 1>,
+    ungap<0, 0, 0, 0, 1, 1, 1>, ungap<1, 0, 0, 0, 1, 1, 1>,
+    ungap<0, 1, 0, 0, 1, 1, 1>, ungap<1, 1, 0, 0, 1, 1, 1>,
+    ungap<0, 0, 1, 0, 1, 1, 1>, ungap<1, 0, 1, 0, 1, 1, 1>,
+    ungap<0, 1, 1, 0, 1, 1, 1>, ungap<1, 1, 1, 0, 1, 1, 1>,
+    ungap<0, 0, 0, 1, 1, 1, 1>, ungap<1, 0, 0, 1, 1, 1, 1>,
+    ungap<0, 1, 0, 1, 1, 1, 1>, ungap<1, 1, 0, 1, 1, 1, 1>,
+    ungap<0, 0, 1, 1, 1, 1, 1>, ungap<1, 0, 1, 1, 1, 1, 1>,
+    ungap<0, 1, 1, 1, 1, 1, 1>, ungap<1, 1, 1, 1, 1, 1, 1>,
+    ungap<0, 0, 0, 0, 0, 0, 0>, ungap<1, 0, 0, 0, 0, 0, 0>,
+    ungap<0, 1, 0, 0, 0, 0, 0>, ungap<1, 1, 0, 0, 0, 0, 0>,
+    ungap<0, 0, 1, 0, 0, 0, 0>, ungap<1, 0, 1, 0, 0, 0, 0>,
+    ungap<0, 1, 1, 0, 0, 0, 0>, ungap<1, 1, 1, 0, 0, 0, 0>,
+    ungap<0, 0, 0, 1, 0, 0, 0>, ungap<1, 0, 0, 1, 0, 0, 0>,
+    ungap<0, 1, 0, 1, 0, 0, 0>, ungap<1, 1, 0, 1, 0, 0, 0>,
+    ungap<0, 0, 1, 1, 0, 0, 0>, ungap<1, 0, 1, 1, 0, 0, 0>,
+    ungap<0, 1, 1, 1, 0, 0, 0>, ungap<1, 1, 1, 1, 0, 0, 0>,
+    ungap<0, 0, 0, 0, 1, 0, 0>, ungap<1, 0, 0, 0, 1, 0, 0>,
+    ungap<0, 1, 0, 0, 1, 0, 0>, ungap<1, 1, 0, 0, 1, 0, 0>,
+    ungap<0, 0, 1, 0, 1, 0, 0>, ungap<1, 0, 1, 0, 1, 0, 0>,
+    ungap<0, 1, 1, 0, 1, 0, 0>, ungap<1, 1, 1, 0, 1, 0, 0>,
+    ungap<0, 0, 0, 1, 1, 0, 0>, ungap<1, 0, 0, 1, 1, 0, 0>,
+    ungap<0, 1, 0, 1, 1, 0, 0>, ungap<1, 1, 0, 1, 1, 0, 0>,
+    ungap<0, 0, 1, 1, 1, 0, 0>, ungap<1, 0, 1, 1, 1, 0, 0>,
+    ungap<0, 1, 1, 1, 1, 0, 0>, ungap<1, 1, 1, 1, 1, 0, 0>,
+    ungap<0, 0, 0, 0, 0, 1, 0>, ungap<1, 0, 0, 0, 0, 1, 0>,
+    ungap<0, 1, 0, 0, 0, 1, 0>, ungap<1, 1, 0, 0, 0, 1, 0>,
+    ungap<0, 0, 1, 0, 0, 1, 0>, ungap<1, 0, 1, 0, 0, 1, 0>,
+    ungap<0, 1, 1, 0, 0, 1, 0>, ungap<1, 1, 1, 0, 0, 1, 0>,
+    ungap<0, 0, 0, 1, 0, 1, 0>, ungap<1, 0, 0, 1, 0, 1, 0>,
+    ungap<0, 1, 0, 1, 0, 1, 0>, ungap<1, 1, 0, 1, 0, 1, 0>,
+    ungap<0, 0, 1, 1, 0, 1, 0>, ungap<1, 0, 1, 1, 0, 1, 0>,
+    ungap<0, 1, 1, 1, 0, 1, 0>, ungap<1, 1, 1, 1, 0, 1, 0>,
+    ungap<0, 0, 0, 0, 1, 1, 0>, ungap<1, 0, 0, 0, 1, 1, 0>,
+    ungap<0, 1, 0, 0, 1, 1, 0>, ungap<1, 1, 0, 0, 1, 1, 0>,
+    ungap<0, 0, 1, 0, 1, 1, 0>, ungap<1, 0, 1, 0, 1, 1, 0>,
+    ungap<0, 1, 1, 0, 1, 1, 0>, ungap<1, 1, 1, 0, 1, 1, 0>,
+    ungap<0, 0, 0, 1, 1, 1, 0>, ungap<1, 0, 0, 1, 1, 1, 0>,
+    ungap<0, 1, 0, 1, 1, 1, 0>, ungap<1, 1, 0, 1, 1, 1, 0>,
+    ungap<0, 0, 1, 1, 1, 1, 0>, ungap<1, 0, 1, 1, 1, 1, 0>,
+    ungap<0, 1, 1, 1, 1, 1, 0>, ungap<1, 1, 1, 1, 1, 1, 0>,
+    ungap<0, 0, 0, 0, 0, 0, 1>, ungap<1, 0, 0, 0, 0, 0, 1>,
+    ungap<0, 1, 0, 0, 0, 0, 1>, ungap<1, 1, 0, 0, 0, 0, 1>,
+    ungap<0, 0, 1, 0, 0, 0, 1>, ungap<1, 0, 1, 0, 0, 0, 1>,
+    ungap<0, 1, 1, 0, 0, 0, 1>, ungap<1, 1, 1, 0, 0, 0, 1>,
+    ungap<0, 0, 0, 1, 0, 0, 1>, ungap<1, 0, 0, 1, 0, 0, 1>,
+    ungap<0, 1, 0, 1, 0, 0, 1>, ungap<1, 1, 0, 1, 0, 0, 1>,
+    ungap<0, 0, 1, 1, 0, 0, 1>, ungap<1, 0, 1, 1, 0, 0, 1>,
+    ungap<0, 1, 1, 1, 0, 0, 1>, ungap<1, 1, 1, 1, 0, 0, 1>,
+    ungap<0, 0, 0, 0, 1, 0, 1>, ungap<1, 0, 0, 0, 1, 0, 1>,
+    ungap<0, 1, 0, 0, 1, 0, 1>, ungap<1, 1, 0, 0, 1, 0, 1>,
+    ungap<0, 0, 1, 0, 1, 0, 1>, ungap<1, 0, 1, 0, 1, 0, 1>,
+    ungap<0, 1, 1, 0, 1, 0, 1>, ungap<1, 1, 1, 0, 1, 0, 1>,
+    ungap<0, 0, 0, 1, 1, 0, 1>, ungap<1, 0, 0, 1, 1, 0, 1>,
+    ungap<0, 1, 0, 1, 1, 0, 1>, ungap<1, 1, 0, 1, 1, 0, 1>,
+    ungap<0, 0, 1, 1, 1, 0, 1>, ungap<1, 0, 1, 1, 1, 0, 1>,
+    ungap<0, 1, 1, 1, 1, 0, 1>, ungap<1, 1, 1, 1, 1, 0, 1>,
+    ungap<0, 0, 0, 0, 0, 1, 1>, ungap<1, 0, 0, 0, 0, 1, 1>,
+    ungap<0, 1, 0, 0, 0, 1, 1>, ungap<1, 1, 0, 0, 0, 1, 1>,
+    ungap<0, 0, 1, 0, 0, 1, 1>, ungap<1, 0, 1, 0, 0, 1, 1>,
+    ungap<0, 1, 1, 0, 0, 1, 1>, ungap<1, 1, 1, 0, 0, 1, 1>,
+    ungap<0, 0, 0, 1, 0, 1, 1>, ungap<1, 0, 0, 1, 0, 1, 1>,
+    ungap<0, 1, 0, 1, 0, 1, 1>, ungap<1, 1, 0, 1, 0, 1, 1>,
+    ungap<0, 0, 1, 1, 0, 1, 1>, ungap<1, 0, 1, 1, 0, 1, 1>,
+    ungap<0, 1, 1, 1, 0, 1, 1>, ungap<1, 1, 1, 1, 0, 1, 1>,
+    ungap<0, 0, 0, 0, 1, 1, 1>, ungap<1, 0, 0, 0, 1, 1, 1>,
+    ungap<0, 1, 0, 0, 1, 1, 1>, ungap<1, 1, 0, 0, 1, 1, 1>,
+    ungap<0, 0, 1, 0, 1, 1, 1>, ungap<1, 0, 1, 0, 1, 1, 1>,
+    ungap<0, 1, 1, 0, 1, 1, 1>, ungap<1, 1, 1, 0, 1, 1, 1>,
+    ungap<0, 0, 0, 1, 1, 1, 1>, ungap<1, 0, 0, 1, 1, 1, 1>,
+    ungap<0, 1, 0, 1, 1, 1, 1>, ungap<1, 1, 0, 1, 1, 1, 1>,
+    ungap<0, 0, 1, 1, 1, 1, 1>, ungap<1, 0, 1, 1, 1, 1, 1>,
+    ungap<0, 1, 1, 1, 1, 1, 1>, ungap<1, 1, 1, 1, 1, 1, 1>};
+
+static inline u32 decode(const u8 *__restrict const in, const u32 length,
+                         u32 *__restrict const out) {
+  assert(length <= SEGMENT);
   if (length == 0) {
     return 0;
   }
@@ -401,17 +464,17 @@ static u32 decode(const u8 *__restrict const in, const u32 length,
     const u32 n_flag_blocks_align32 = ((n_flag_blocks + 31u) / 32u) * 32u;
     in_offset += n_flag_blocks_align32;
 
-    a32_vector<u8> flags(n_blocks + 1u, 0);
+    alignas(32) u8 flags[FLAGS_BYTE];
     const u32 N = n_flag_blocks / YMM_BYTE;
     for (u32 i = 0; i < N; i++) {
       const auto reg =
           _mm256_load_si256(reinterpret_cast<__m256icpc>(in + YMM_BYTE * i));
       _mm256_store_si256(
-          reinterpret_cast<__m256ipc>(flags.data() + YMM_BYTE * (i * 2u)),
+          reinterpret_cast<__m256ipc>(flags + YMM_BYTE * (i * 2u)),
           _mm256_and_si256(
               reg, _mm256_load_si256(reinterpret_cast<__m256icpc>(mask8r[4]))));
       _mm256_store_si256(
-          reinterpret_cast<__m256ipc>(flags.data() + YMM_BYTE * (i * 2u + 1u)),
+          reinterpret_cast<__m256ipc>(flags + YMM_BYTE * (i * 2u + 1u)),
           _mm256_srli_epi8(reg, 4u));
     }
 
@@ -466,21 +529,17 @@ static u32 decode(const u8 *__restrict const in, const u32 length,
     const u32 consumed =
         ungaps[in[in_offset]](in + in_offset + 1u, prev, out + out_offset);
 
-    in_offset += 1u +          // flags
-                 consumed;     // remains
-    out_offset += LENGTH - 1u; // at most
-
-    // revert overrun
-    in_offset -= (out_offset - length) * 2u;
-    /*out_offset -= out_offset - length;*/
+    // consumed includes the overrun, which encode pads and one more
+    in_offset += 1u + consumed + 2u;
   }
 
-  return in_offset;
+  return (in_offset + 31u) / 32u * 32u; // as encode
 }
 
 template <typename Func /*(unpacked_datum, local_idx)*/>
-static u32 foreach (const hoshizora::u8 *__restrict in, const u32 length,
+static inline u32 foreach (const u8 *__restrict in, const u32 length,
                     Func f) {
+  assert(length <= SEGMENT);
   if (length == 0) {
     return 0;
   }
@@ -496,17 +555,17 @@ static u32 foreach (const hoshizora::u8 *__restrict in, const u32 length,
     const u32 n_flag_blocks_align32 = ((n_flag_blocks + 31u) / 32u) * 32u;
     in_offset += n_flag_blocks_align32;
 
-    a32_vector<u8> flags(n_blocks + 1u, 0);
+    alignas(32) u8 flags[FLAGS_BYTE];
     const u32 N = n_flag_blocks / YMM_BYTE;
     for (u32 i = 0; i < N; i++) {
       const auto reg =
           _mm256_load_si256(reinterpret_cast<__m256icpc>(in + YMM_BYTE * i));
       _mm256_store_si256(
-          reinterpret_cast<__m256ipc>(flags.data() + YMM_BYTE * (i * 2u)),
+          reinterpret_cast<__m256ipc>(flags + YMM_BYTE * (i * 2u)),
           _mm256_and_si256(
               reg, _mm256_load_si256(reinterpret_cast<__m256icpc>(mask8r[4]))));
       _mm256_store_si256(
-          reinterpret_cast<__m256ipc>(flags.data() + YMM_BYTE * (i * 2u + 1u)),
+          reinterpret_cast<__m256ipc>(flags + YMM_BYTE * (i * 2u + 1u)),
           _mm256_srli_epi8(reg, 4u));
     }
     for (u32 i = N * YMM_BYTE * 2u; i < n_blocks; i += 2u) {
@@ -559,21 +618,19 @@ static u32 foreach (const hoshizora::u8 *__restrict in, const u32 length,
 
   const u32 remain = length - out_offset;
   if (remain > 0u) {
-    const u32 consumed =
-        ungaps[in[in_offset]](in + in_offset + 1u, out[LENGTH - 1u], out);
+    const u32 prev = n_blocks == 0 ? 0 : out[LENGTH - 1u];
+    const u32 consumed = ungaps[in[in_offset]](in + in_offset + 1u, prev, out);
     for (u32 i = 0; i < remain; i++) {
       f(out[i], out_offset + i);
     }
 
-    in_offset += 1u + consumed;
-    out_offset += LENGTH - 1u;
-
-    // revert overrun
-    in_offset -= (out_offset - length) * 2u;
-    /*out_offset -= out_offset - length;*/
+    // consumed includes the overrun, which encode pads and one more
+    in_offset += 1u + consumed + 2u;
   }
 
-  return in_offset;
+  return (in_offset + 31u) / 32u * 32u; // as encode
 }
-} // namespace hoshizora::compress::single
-#endif // SINGLE_H
+} // namespace single
+} // namespace compress
+} // namespace hoshizora
+#endif // HOSHIZORA_COMPRESS_SINGLE_H
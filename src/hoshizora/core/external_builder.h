@@ -0,0 +1,359 @@
+#ifndef HOSHIZORA_EXTERNAL_BUILDER_H
+#define HOSHIZORA_EXTERNAL_BUILDER_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "hoshizora/core/colle.h"
+#include "hoshizora/core/graph.h"
+#include "hoshizora/core/includes.h"
+#include "hoshizora/core/loop.h"
+
+namespace hoshizora {
+namespace external {
+// LSD radix sort by 8-bit digits. digits shared by all keys (e.g. high bytes
+// of small IDs) are skipped
+static inline void radix_sort(u64 *const keys, u64 *const tmp, const u64 n) {
+  if (n == 0) {
+    return;
+  }
+
+  auto from = keys;
+  auto to = tmp;
+  for (u32 shift = 0; shift < 64; shift += 8) {
+    u64 counts[256] = {};
+    for (u64 i = 0; i < n; ++i) {
+      counts[(from[i] >> shift) & 0xFFu]++;
+    }
+    if (counts[(from[0] >> shift) & 0xFFu] == n) {
+      continue;
+    }
+
+    u64 acc = 0;
+    for (auto &count : counts) {
+      const auto c = count;
+      count = acc;
+      acc += c;
+    }
+    for (u64 i = 0; i < n; ++i) {
+      to[counts[(from[i] >> shift) & 0xFFu]++] = from[i];
+    }
+    std::swap(from, to);
+  }
+
+  if (from != keys) {
+    std::memcpy(keys, from, sizeof(u64) * n);
+  }
+}
+
+// sorted run of keys on disk, read back through a fixed-size buffer
+struct RunReader {
+  std::ifstream ifs;
+  std::vector<u64> buffer;
+  u64 pos = 0;
+  u64 length = 0;
+
+  RunReader(const std::string &file_name, const u64 buffer_length)
+      : ifs(file_name, std::ios::in | std::ios::binary),
+        buffer(buffer_length) {
+    if (!ifs) {
+      throw std::runtime_error("Cannot open " + file_name);
+    }
+  }
+
+  bool next(u64 &key) {
+    if (pos == length) {
+      ifs.read(reinterpret_cast<char *>(buffer.data()),
+               sizeof(u64) * buffer.size());
+      length = static_cast<u64>(ifs.gcount()) / sizeof(u64);
+      pos = 0;
+      if (length == 0) {
+        return false;
+      }
+    }
+    key = buffer[pos++];
+    return true;
+  }
+};
+
+// k-way merge of sorted runs within `memory_budget` bytes of read buffers
+template <class Func /*(key)*/>
+static inline void merge(const std::vector<std::string> &runs,
+                         const u64 memory_budget, Func f) {
+  using Head = std::pair<u64, u32>; // (key, run)
+
+  const auto buffer_length =
+      std::max(memory_budget / sizeof(u64) / std::max(runs.size(), 1ul),
+               512ul); // at least a 4KiB page per run
+  std::vector<std::unique_ptr<RunReader>> readers;
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+  for (u32 n = 0; n < runs.size(); ++n) {
+    readers.emplace_back(std::make_unique<RunReader>(runs[n], buffer_length));
+    u64 key;
+    if (readers[n]->next(key)) {
+      heads.emplace(key, n);
+    }
+  }
+
+  while (!heads.empty()) {
+    const auto head = heads.top();
+    heads.pop();
+    f(head.first);
+    u64 key;
+    if (readers[head.second]->next(key)) {
+      heads.emplace(key, head.second);
+    }
+  }
+}
+} // namespace external
+
+/*
+ * Builds a Graph from edges which do not fit into memory at once.
+ *
+ * Edges are pushed as bounded runs, each run is radix-sorted by (src, dst)
+ * and by (dst, src) and spilled to `spill_dir`. `build` then k-way merges
+ * the spilled runs straight into the per-thread out/in index chunks, so
+ * the working set is `memory_budget` plus O(#vertices) offsets.
+ */
+template <class Graph> struct ExternalBuilder {
+  using ID = typename Graph::_ID;
+  static_assert(sizeof(ID) <= sizeof(u32), "ID must fit into a half key");
+
+  const u64 memory_budget;
+  const std::string spill_dir;
+
+  std::vector<std::string> out_runs;
+  std::vector<std::string> in_runs;
+  std::vector<ID> out_degrees;
+  std::vector<ID> in_degrees;
+  u64 num_edges = 0;
+
+  std::vector<u64> keys;
+  std::vector<u64> tmp_keys;
+
+  ExternalBuilder(const u64 memory_budget, const std::string &spill_dir)
+      : memory_budget(memory_budget), spill_dir(spill_dir) {}
+
+  ExternalBuilder(const ExternalBuilder &) = delete;
+
+  ExternalBuilder &operator=(const ExternalBuilder &) = delete;
+
+  ~ExternalBuilder() {
+    for (const auto &run : out_runs) {
+      std::remove(run.c_str());
+    }
+    for (const auto &run : in_runs) {
+      std::remove(run.c_str());
+    }
+  }
+
+  // #edges of a single run: pushed edges + keys + radix buffer. at least a
+  // page, so that a run always fits a page of text (>= 2 bytes per edge)
+  u64 run_capacity() const {
+    return std::max(memory_budget / (sizeof(std::pair<ID, ID>) +
+                                     sizeof(u64) + sizeof(u64)),
+                    static_cast<u64>(sysconf(_SC_PAGESIZE)));
+  }
+
+  void add_run(const std::vector<std::pair<ID, ID>> &edge_list) {
+    if (edge_list.empty()) {
+      return;
+    }
+    assert(edge_list.size() <= run_capacity());
+
+    const auto n = edge_list.size();
+    keys.resize(n);
+    tmp_keys.resize(n);
+
+    ID max_id = 0;
+    for (const auto &edge : edge_list) {
+      max_id = std::max(max_id, std::max(edge.first, edge.second));
+    }
+    if (max_id >= out_degrees.size()) {
+      out_degrees.resize(max_id + 1ul, 0);
+      in_degrees.resize(max_id + 1ul, 0);
+    }
+
+    for (u64 i = 0; i < n; ++i) {
+      const auto &edge = edge_list[i];
+      out_degrees[edge.first]++;
+      keys[i] = static_cast<u64>(edge.first) << 32u | edge.second;
+    }
+    spill(out_runs, ".out");
+
+    // an undirected self-loop is kept once, by its out-run
+    u64 num_keys = 0;
+    for (u64 i = 0; i < n; ++i) {
+      const auto &edge = edge_list[i];
+      if (Graph::is_directed || edge.first != edge.second) {
+        in_degrees[edge.second]++;
+        keys[num_keys++] = static_cast<u64>(edge.second) << 32u | edge.first;
+      }
+    }
+    keys.resize(num_keys);
+    spill(in_runs, ".in");
+
+    num_edges += n;
+  }
+
+  /*
+   * runs of a direction the graph does not keep are left unmerged. an
+   * undirected graph merges in-runs, keyed (dst, src), into its only CSR.
+   * with `cleanup`, the merged out-lists are cleaned and transposed in
+   * memory instead of merging in-runs
+   */
+  Graph build(const Direction direction = Direction::Both,
+              const Cleanup &cleanup = Cleanup()) {
+    assert(num_edges > 0);
+    std::vector<u64>().swap(keys);
+    std::vector<u64>().swap(tmp_keys);
+
+    auto g = Graph();
+    g.direction = direction;
+    g.cleanup = cleanup;
+    g.num_vertices = static_cast<ID>(out_degrees.size());
+    g.num_edges = static_cast<ID>(num_edges);
+    debug::logger->info("merge {} runs of {} edges", out_runs.size(),
+                        num_edges);
+
+    if (!Graph::is_directed) {
+      for (u64 v = 0; v < out_degrees.size(); ++v) {
+        out_degrees[v] += in_degrees[v];
+      }
+      std::vector<std::string> runs(out_runs);
+      runs.insert(runs.end(), in_runs.begin(), in_runs.end());
+      g.tmp_out_offsets = to_offsets(out_degrees);
+      g.num_edges = g.tmp_out_offsets[g.num_vertices];
+      g.set_boundaries(nullptr);
+      g.set_out_offsets();
+      merge_into(g.out_indices, g.out_offsets, g.out_boundaries, runs);
+      g.out_indices_is_initialized = true;
+      if (cleanup.any()) {
+        g.num_edges = Graph::clean_lists(cleanup, g.out_boundaries,
+                                         g.out_offsets, g.out_indices);
+      }
+
+      g.share_in_with_out();
+      if (direction == Direction::Both) {
+        g.set_forward_indices();
+        g.set_e_data();
+      }
+      g.set_v_data();
+      return g;
+    }
+
+    g.tmp_out_offsets = to_offsets(out_degrees);
+    g.tmp_in_offsets = to_offsets(in_degrees);
+    g.set_boundaries(g.tmp_in_offsets);
+    g.set_out_offsets();
+    if (cleanup.any()) {
+      g.free_offsets(g.tmp_in_offsets); // recounted after cleanup
+      merge_into(g.out_indices, g.out_offsets, g.out_boundaries, out_runs);
+      g.set_rest_from_out();
+      return g;
+    }
+    if (g.has_out_edges()) {
+      merge_into(g.out_indices, g.out_offsets, g.out_boundaries, out_runs);
+      g.out_indices_is_initialized = true;
+    }
+
+    g.set_in_offsets();
+    if (g.has_in_edges()) {
+      merge_into(g.in_indices, g.in_offsets, g.in_boundaries, in_runs);
+      g.in_indices_is_initialized = true;
+    }
+
+    if (direction == Direction::Both) {
+      g.set_forward_indices();
+      g.set_e_data();
+    }
+    g.set_v_data();
+
+    return g;
+  }
+
+private:
+  void spill(std::vector<std::string> &runs, const char *suffix) {
+    external::radix_sort(keys.data(), tmp_keys.data(), keys.size());
+
+    const auto file_name = spill_dir + "/hoshizora-" +
+                           std::to_string(getpid()) + "-" +
+                           std::to_string(reinterpret_cast<uintptr_t>(this)) +
+                           "-" + std::to_string(runs.size()) + suffix;
+    std::ofstream ofs(file_name,
+                      std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+      throw std::runtime_error("Cannot create " + file_name);
+    }
+    // the file is listed before any check so that it is removed either way
+    runs.emplace_back(file_name);
+    ofs.write(reinterpret_cast<const char *>(keys.data()),
+              sizeof(u64) * keys.size());
+    ofs.flush();
+    ofs.close();
+    if (!ofs) {
+      throw std::runtime_error("Cannot write " + file_name);
+    }
+  }
+
+  // consumes degrees
+  static ID *to_offsets(std::vector<ID> &degrees) {
+    const auto num_vertices = degrees.size();
+    const auto offsets = mem::malloc<ID>(num_vertices + 1);
+    offsets[0] = 0;
+    for (u64 i = 0; i < num_vertices; ++i) {
+      offsets[i + 1] = offsets[i] + degrees[i];
+    }
+    std::vector<ID>().swap(degrees);
+    return offsets;
+  }
+
+  void merge_into(colle::DiscreteArray<ID> &indices,
+                  const colle::DiscreteArray<ID> &offsets,
+                  const ID *const boundaries,
+                  const std::vector<std::string> &runs) const {
+    std::vector<u64> chunk_ends;
+    loop::each_thread(boundaries, [&](u32 thread_id, u32 numa_id, ID lower,
+                                      ID upper) {
+      const auto start = offsets(lower, thread_id, 0);
+      const auto end = offsets(upper, thread_id, 0);
+      const auto chunk = mem::malloc<ID>(end - start, numa_id);
+      indices.add(chunk, end - start);
+      indices.own(chunk, end - start);
+      chunk_ends.emplace_back(end);
+    });
+
+    // merged keys come in CSR order, so they are written sequentially.
+    // runs shorter or longer than counted (e.g. cut off by a full disk)
+    // would leave chunks partly uninitialized or overrun them
+    const u64 num_keys = chunk_ends.empty() ? 0 : chunk_ends.back();
+    u64 pos = 0;
+    u32 chunk = 0;
+    external::merge(runs, memory_budget, [&](const u64 key) {
+      if (pos >= num_keys) {
+        throw std::runtime_error("Spilled runs hold more edges than counted");
+      }
+      while (pos >= chunk_ends[chunk]) {
+        chunk++;
+      }
+      indices.data[chunk][pos - indices.range[chunk]] =
+          static_cast<ID>(key & 0xFFFFFFFFu);
+      pos++;
+    });
+    if (pos != num_keys) {
+      throw std::runtime_error("Spilled runs hold fewer edges than counted");
+    }
+  }
+};
+} // namespace hoshizora
+
+#endif // HOSHIZORA_EXTERNAL_BUILDER_H
@@ -0,0 +1,118 @@
+#ifndef HOSHIZORA_FORK_JOIN_POOL_H
+#define HOSHIZORA_FORK_JOIN_POOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "hoshizora/core/includes.h"
+
+namespace hoshizora {
+/*
+ * `num_threads` workers pinned to CPUs and kept for the whole process.
+ * run() hands the same task to all of them and returns once all are done,
+ * so every phase runs on the same cores (and first-touches its pages on the
+ * same NUMA nodes) as the next one without spawning threads each time.
+ * an exception thrown by the task is kept (the first one if several) and
+ * rethrown by run() once all workers are done, instead of terminating
+ */
+struct ForkJoinPool {
+  const u32 num_threads;
+  std::vector<std::thread> workers;
+  std::mutex run_mtx; // one run at a time
+  std::mutex mtx;
+  std::condition_variable started;
+  std::condition_variable finished;
+  const std::function<void(u32)> *task = nullptr;
+  u64 generation = 0;
+  u32 num_running = 0;
+  bool quit = false;
+  std::exception_ptr error;
+
+  explicit ForkJoinPool(const u32 num_threads) : num_threads(num_threads) {
+    for (u32 thread_id = 0; thread_id < num_threads; ++thread_id) {
+      workers.emplace_back([this, thread_id]() { work(thread_id); });
+    }
+  }
+
+  ~ForkJoinPool() {
+    {
+      auto lock = std::unique_lock<std::mutex>(mtx);
+      quit = true;
+    }
+    started.notify_all();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  // true on workers, which cannot run() again until their task returns
+  static bool &in_worker() {
+    static thread_local bool flag = false;
+    return flag;
+  }
+
+  void run(const std::function<void(u32)> &f) {
+    assert(!in_worker());
+    auto run_lock = std::unique_lock<std::mutex>(run_mtx);
+    auto lock = std::unique_lock<std::mutex>(mtx);
+    task = &f;
+    num_running = num_threads;
+    generation++;
+    started.notify_all();
+    finished.wait(lock, [this]() { return num_running == 0; });
+    task = nullptr;
+    if (error) {
+      std::exception_ptr thrown;
+      std::swap(thrown, error);
+      std::rethrow_exception(thrown);
+    }
+  }
+
+  static void pin(const u32 thread_id) {
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(thread_id, &cpuset); // FIXME: same as BulkSyncThreadPool
+    sched_setaffinity(0, sizeof(cpu_set_t), &cpuset);
+#endif
+  }
+
+  void work(const u32 thread_id) {
+    pin(thread_id);
+    in_worker() = true;
+    u64 done = 0;
+    auto lock = std::unique_lock<std::mutex>(mtx);
+    while (true) {
+      started.wait(lock, [&]() { return quit || generation != done; });
+      if (quit) {
+        return;
+      }
+      done = generation;
+      const auto &f = *task;
+      lock.unlock();
+      std::exception_ptr thrown;
+      try {
+        f(thread_id);
+      } catch (...) {
+        thrown = std::current_exception();
+      }
+      lock.lock();
+      if (thrown && !error) {
+        error = thrown;
+      }
+      if (--num_running == 0) {
+        finished.notify_one();
+      }
+    }
+  }
+};
+} // namespace hoshizora
+
+#endif // HOSHIZORA_FORK_JOIN_POOL_H
@@ -2,19 +2,51 @@
 #define HOSHIZORA_GRAPH_H
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <iostream>
-#include <set>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
 #include <thread>
 #include <tuple>
+#include <type_traits>
+#include <unordered_set>
 #include <vector>
 
 #include "hoshizora/core/colle.h"
+#include "hoshizora/core/compress/multiple.h"
 #include "hoshizora/core/includes.h"
 #include "hoshizora/core/loop.h"
+#include "hoshizora/core/mapped_file.h"
+#include "hoshizora/core/snapshot.h"
 
 namespace hoshizora {
+// edges a kernel walks. a graph built for one direction still keeps
+// out_offsets (so out-degrees), but not the other CSR, forward_indices and
+// e_data, which only the push-gather path of BulkSyncGASExecutor reads
+enum class Direction : u8 { Out = 1, In = 2, Both = 3 };
+
+// optional passes over the sorted lists of a CSR being built
+struct Cleanup {
+  bool duplicates = false; // keeps one of parallel edges
+  bool self_loops = false; // drops (v, v)
+
+  inline bool any() const { return duplicates || self_loops; }
+};
+
+// relabeling of vertices before building, see reorder.h
+enum class Reordering : u8 {
+  None,
+  Degree, // by descending degree
+  Hub,    // vertices above the average degree first, otherwise as they are
+  Rcm,    // reverse Cuthill-McKee
+};
+
 /*
  * #blocks = 2
  * data:       [3 | 8 | 2 | 3 | 3 | 6 | 4]
@@ -29,6 +61,10 @@ namespace hoshizora {
  * } {
  *   data[i] // 3, 8, 2, 3
  * }
+ *
+ * an undirected Graph (IsDirected = false) keeps a single CSR holding both
+ * directions of each edge (a self-loop once), in_* share the arrays of out_*
+ * and forward_indices map each slot to the slot of its reverse edge
  */
 template <class ID, class VProp, class EProp, class VData, class EData,
           bool IsDirected = true>
@@ -39,10 +75,11 @@ struct Graph {
   using _VData = VData;
   using _EData = EData;
   using _Graph = Graph<ID, VProp, EProp, VData, EData, IsDirected>;
+  static constexpr bool is_directed = IsDirected;
 
   // TODO
-  const u32 num_threads = loop::num_threads;
-  const u32 num_numa_nodes = loop::num_numa_nodes;
+  u32 num_threads = loop::num_threads;
+  u32 num_numa_nodes = loop::num_numa_nodes;
 
   ID num_vertices;
   ID num_edges;
@@ -52,22 +89,25 @@ struct Graph {
   ID *tmp_in_offsets;
   ID *tmp_in_indices;
 
-  colle::DiscreteArray<ID> out_degrees;     // [#vertices]
-  colle::DiscreteArray<ID> out_offsets;     // [#vertices]
-  colle::DiscreteArray<ID *> out_neighbors; // [#vertices][degrees[i]]
-  colle::DiscreteArray<ID> in_degrees;
+  // [#vertices], each chunk followed by the offset after its last vertex,
+  // so degrees and neighbors are derived (see out_degree, out_neighbors)
+  colle::DiscreteArray<ID> out_offsets;
   colle::DiscreteArray<ID> in_offsets;
-  colle::DiscreteArray<ID *> in_neighbors;
-
-  // colle::DiscreteArray<u8> out_indices; // [#edges]
-  // colle::DiscreteArray<u8> in_indices;  // [#edges]
 
   colle::DiscreteArray<ID> out_indices; // [#edges]
   colle::DiscreteArray<ID> in_indices;  // [#edges]
-
-  ID *forward_indices; // [num_edges]
+  // in-lists of each chunk packed by compress::multiple in place of
+  // in_indices, see compress_in_indices
+  colle::DiscreteArray<u8> in_compressed; // [#bytes]
+  // byte of every compress::multiple::SKIP_INTERVAL-th in-list of a chunk,
+  // from its first vertex, for in_list_pos
+  colle::DiscreteArray<u64> in_skips; // [#vertices / SKIP_INTERVAL]
+
+  colle::DiscreteArray<ID> forward_indices; // [#edges], as out_indices
   ID *out_boundaries;
   ID *in_boundaries;
+  // frees boundaries computed by set_boundaries, null for mapped ones
+  std::shared_ptr<ID> owned_boundaries;
 
   // TMP
   std::vector<VProp> v_props;                         // [#vertices]
@@ -76,30 +116,48 @@ struct Graph {
   colle::DiscreteArray<VData> v_data; // [#vertices]
   colle::DiscreteArray<EData> e_data; // [#edges]
 
+  // EProp of each out-edge parsed from the input (e.g. weights), aligned
+  // with out_indices and empty if the input has none. non-arithmetic EProp
+  // (empty_t) cannot be stored in chunks, so it falls back to f32
+  using _EPropColumn =
+      typename std::conditional<std::is_arithmetic<EProp>::value, EProp,
+                                f32>::type;
+  static constexpr bool has_e_prop_column = std::is_arithmetic<EProp>::value;
+  colle::DiscreteArray<_EPropColumn> out_e_props; // [#edges]
+
   colle::DiscreteArray<bool> active_flags; // [#vertices]
 
+  // [#vertices] -> original ID, empty unless IDs were remapped or
+  // reordered on load
+  std::vector<u64> external_ids;
+  // [rank of original ID] -> vertex, empty unless reordered. remapped IDs
+  // alone are numbered in ascending order and need no inverse
+  std::vector<ID> internal_ids;
+  Reordering reordering = Reordering::None;
+
+  // keeps the snapshot mapped while topology arrays point into it
+  std::shared_ptr<MappedFile> snapshot_file;
+
   // std::shared_ptr<std::vector<VData>> extra_results;
   // std::shared_ptr<std::vector<std::pair<ID, f32>>> extra_results; // TMP
 
   bool changed = false;
-  u32 num_all_edges = 0;
+  f64 num_all_edges = 0; // m of modularity, the sum of edge weights
 
-  bool out_degrees_is_initialized = false;
   bool out_offsets_is_initialized = false;
   bool out_indices_is_initialized = false;
-  bool in_degrees_is_initialized = false;
   bool in_offsets_is_initialized = false;
   bool in_indices_is_initialized = false;
   bool out_boundaries_is_initialized = false;
   bool in_boundaries_is_initialized = false;
   bool forward_indices_is_initialized = false;
+  bool in_indices_is_compressed = false;
+
+  Direction direction = Direction::Both;
+  Cleanup cleanup; // applied while building
 
   explicit Graph(const bool use_extra_result = false)
-      : out_degrees(colle::DiscreteArray<ID>()),
-        out_neighbors(colle::DiscreteArray<ID *>()),
-        in_degrees(colle::DiscreteArray<ID>()),
-        in_neighbors(colle::DiscreteArray<ID *>()),
-        v_data(colle::DiscreteArray<VData>()),
+      : v_data(colle::DiscreteArray<VData>()),
         e_data(colle::DiscreteArray<EData>()) {
     // if (use_extra_result) {
     //  extra_results = std::make_shared<std::vector<std::pair<ID, f32>>>();
@@ -111,76 +169,335 @@ struct Graph {
   }
 
   explicit Graph(std::shared_ptr<std::vector<std::pair<ID, f32>>> extra_results)
-      : out_degrees(colle::DiscreteArray<ID>()),
-        out_neighbors(colle::DiscreteArray<ID *>()),
-        in_degrees(colle::DiscreteArray<ID>()),
-        in_neighbors(colle::DiscreteArray<ID *>()),
-        v_data(colle::DiscreteArray<VData>()),
+      : v_data(colle::DiscreteArray<VData>()),
         e_data(
             colle::DiscreteArray<EData>()) /*, extra_results(extra_results) */ {
   }
 
-  Graph &operator=(const Graph &graph) {
-    // FIXME: A lot of memory leaks
-    this->changed = false;
-    this->num_all_edges = graph.num_all_edges;
-    this->num_edges = graph.num_edges;
-    this->num_vertices = graph.num_vertices;
-    this->out_degrees = graph.out_degrees;
-    this->out_neighbors = graph.out_neighbors;
-    this->out_offsets = graph.out_offsets;
-    this->out_indices = graph.out_indices;
-    this->out_boundaries = graph.out_boundaries;
-    this->in_degrees = graph.in_degrees;
-    this->in_neighbors = graph.in_neighbors;
-    this->in_offsets = graph.in_offsets;
-    this->in_indices = graph.in_indices;
-    this->in_boundaries = graph.in_boundaries;
-    this->forward_indices = graph.forward_indices;
-    this->v_data = graph.v_data;
-    this->e_data = graph.e_data;
-    this->v_props = graph.v_props;
-    this->e_props = graph.e_props;
-    return *this;
-  }
-
-  void set_out_boundaries() {
-    assert(!out_offsets_is_initialized);
-
-    const auto chunk_size = num_edges / num_threads;
-    out_boundaries = mem::calloc<ID>(num_threads + 1);
-    for (u32 thread_id = 1; thread_id < num_threads; ++thread_id) {
-      out_boundaries[thread_id] = static_cast<ID>(std::distance(
-          tmp_out_offsets,
-          std::lower_bound(tmp_out_offsets, tmp_out_offsets + num_vertices,
-                           chunk_size * thread_id)));
-    }
-    out_boundaries[num_threads] = num_vertices;
+  // chunks are owned, so a Graph is only moved. rebind() shares topology
+  Graph(const Graph &) = delete;
+  Graph &operator=(const Graph &) = delete;
+  Graph(Graph &&) = default;
+  Graph &operator=(Graph &&) = default;
+
+  /*
+   * bytes of memory held by this graph: owned chunks, boundaries and IDs.
+   * blocks shared with in_* or another rebound graph count once here, and
+   * sections mapped from a snapshot are not counted
+   */
+  u64 memory_usage() const {
+    std::unordered_set<const void *> seen;
+    u64 bytes = 0;
+    const auto count = [&](const auto &array) {
+      if (array.blocks && seen.insert(array.blocks.get()).second) {
+        bytes += array.bytes();
+      }
+    };
+    count(out_offsets);
+    count(out_indices);
+    count(in_offsets);
+    count(in_indices);
+    count(in_compressed);
+    count(in_skips);
+    count(forward_indices);
+    count(v_data);
+    count(e_data);
+    count(out_e_props);
+    count(active_flags);
+    if (owned_boundaries) {
+      bytes += sizeof(ID) * (num_threads + 1);
+    }
+    bytes += sizeof(u64) * external_ids.capacity();
+    bytes += sizeof(ID) * internal_ids.capacity();
+    return bytes;
+  }
 
-    out_boundaries_is_initialized = true;
+  inline bool has_out_edges() const {
+    return !IsDirected || direction != Direction::In;
+  }
+
+  inline bool has_in_edges() const {
+    return !IsDirected || direction != Direction::Out;
+  }
+
+  /*
+   * edges of a vertex `v` in chunk `n` (its thread) from offsets alone: the
+   * degree is the distance to the next offset, which is in the same chunk,
+   * and neighbors start at the offset in the chunk of indices of `n`.
+   * without `n`, the chunk is looked up. degrees are kept without indices
+   * (e.g. out-degrees of an in-only graph), neighbors need indices
+   */
+  inline ID out_degree(const ID v, const u32 n) const {
+    return out_offsets(v + 1, n, 0) - out_offsets(v, n, 0);
+  }
+
+  inline ID out_degree(const ID v) const {
+    return out_degree(v, out_offsets.chunk_of(v));
+  }
+
+  inline ID *out_neighbors(const ID v, const u32 n) const {
+    return out_indices.data[n] + (out_offsets(v, n, 0) - out_indices.range[n]);
+  }
+
+  inline ID *out_neighbors(const ID v) const {
+    return out_neighbors(v, out_offsets.chunk_of(v));
+  }
+
+  inline ID in_degree(const ID v, const u32 n) const {
+    return in_offsets(v + 1, n, 0) - in_offsets(v, n, 0);
+  }
+
+  inline ID in_degree(const ID v) const {
+    return in_degree(v, in_offsets.chunk_of(v));
+  }
+
+  inline ID *in_neighbors(const ID v, const u32 n) const {
+    return in_indices.data[n] + (in_offsets(v, n, 0) - in_indices.range[n]);
+  }
+
+  inline ID *in_neighbors(const ID v) const {
+    return in_neighbors(v, in_offsets.chunk_of(v));
+  }
+
+  /*
+   * visits in-neighbors of `dst` in chunk `n` as f(src), in order. compressed
+   * lists are decoded while visited from byte `pos` of the chunk, where the
+   * list of `dst` starts: the first vertex of a chunk starts at 0 and the
+   * rest where the previous one returns, so a chunk is walked in order
+   */
+  template <class Func /*(src)*/>
+  inline u64 each_in_neighbor(const ID dst, const u32 n, const u64 pos,
+                              Func f) const {
+    const auto degree = in_degree(dst, n);
+    if (in_indices_is_compressed) {
+      return compress::multiple::foreach_list(in_compressed.data[n], pos,
+                                              degree, f);
+    }
+    const auto srcs = in_neighbors(dst, n);
+    for (ID i = 0; i < degree; ++i) {
+      f(srcs[i]);
+    }
+    return pos;
   }
 
-  void set_in_boundaries() {
-    assert(!in_offsets_is_initialized);
+  // byte of the compressed in-list of `dst` in chunk `n`, where the walk of
+  // each_in_neighbor would reach it. only the lists after the nearest skip
+  // are stepped over, none is decoded
+  inline u64 in_list_pos(const ID dst, const u32 n) const {
+    return compress::multiple::seek(in_compressed.data[n], in_offsets.data[n],
+                                    in_skips.data[n], dst - in_offsets.range[n]);
+  }
 
-    const auto chunk_size = num_edges / num_threads;
-    in_boundaries = mem::calloc<ID>(num_threads + 1);
-    for (u32 thread_id = 1; thread_id < num_threads; ++thread_id) {
-      in_boundaries[thread_id] = static_cast<ID>(std::distance(
-          tmp_in_offsets,
-          std::lower_bound(tmp_in_offsets, tmp_in_offsets + num_vertices,
-                           chunk_size * thread_id)));
+  /*
+   * visits neighbors of a single vertex as f(neighbor), compressed or not,
+   * e.g. for point queries or walks in no particular order. an undirected
+   * graph reads out-edges from its in-lists once they are compressed
+   */
+  template <class Func /*(src)*/>
+  inline void each_in_neighbor(const ID dst, Func f) const {
+    const auto n = in_offsets.chunk_of(dst);
+    each_in_neighbor(dst, n, in_indices_is_compressed ? in_list_pos(dst, n) : 0,
+                     f);
+  }
+
+  template <class Func /*(dst)*/>
+  inline void each_out_neighbor(const ID src, Func f) const {
+    if (!IsDirected && in_indices_is_compressed) {
+      each_in_neighbor(src, f);
+      return;
+    }
+    const auto n = out_offsets.chunk_of(src);
+    const auto dsts = out_neighbors(src, n);
+    for (ID i = 0, degree = out_degree(src, n); i < degree; ++i) {
+      f(dsts[i]);
     }
-    in_boundaries[num_threads] = num_vertices;
+  }
+
+  // slot of the i-th out-edge of `src` (the `index`-th of all) among the
+  // in-edges of its destination, the reverse slot if undirected
+  inline ID forward_index(const ID src, const ID i, const ID index,
+                          const u32 thread_id) const {
+    return forward_indices(index, thread_id, 0);
+  }
+
+  // an undirected graph has no other CSR, in-edges are its out-edges
+  void share_in_with_out() {
+    assert(!IsDirected);
+    assert(out_offsets_is_initialized && out_indices_is_initialized);
 
+    in_boundaries = out_boundaries;
+    in_offsets = out_offsets.share();
+    in_indices = out_indices.share();
     in_boundaries_is_initialized = true;
+    in_offsets_is_initialized = true;
+    in_indices_is_initialized = true;
+  }
+
+  inline u64 external_id(const ID v) const {
+    return external_ids.empty() ? v : external_ids[v];
+  }
+
+  // inverse of external_id, by a binary search over original IDs in
+  // ascending order
+  ID internal_id(const u64 external) const {
+    if (external_ids.empty()) {
+      if (external >= num_vertices) {
+        throw std::out_of_range("No such vertex: " + std::to_string(external));
+      }
+      return static_cast<ID>(external);
+    }
+    const auto vertex = [this](const u64 rank) {
+      return internal_ids.empty() ? static_cast<ID>(rank) : internal_ids[rank];
+    };
+    u64 lower = 0, upper = external_ids.size();
+    while (lower < upper) {
+      const auto mid = (lower + upper) / 2;
+      if (external_ids[vertex(mid)] < external) {
+        lower = mid + 1;
+      } else {
+        upper = mid;
+      }
+    }
+    if (lower == external_ids.size() ||
+        external_ids[vertex(lower)] != external) {
+      throw std::out_of_range("No such vertex: " + std::to_string(external));
+    }
+    return vertex(lower);
+  }
+
+  // internal_ids of a reordered graph from external_ids
+  void set_internal_ids() {
+    internal_ids.resize(external_ids.size());
+    std::iota(internal_ids.begin(), internal_ids.end(), 0);
+    std::sort(internal_ids.begin(), internal_ids.end(),
+              [this](const ID a, const ID b) {
+                return external_ids[a] < external_ids[b];
+              });
+  }
+
+  /*
+   * appends a chunk per thread to `array`, each made by
+   * f(thread_id, numa_id, lower, upper) -> (chunk, length) on that thread so
+   * that its pages are first touched by the thread processing them later.
+   * chunks are from mem::malloc and owned by `array`
+   */
+  template <class T, class Func>
+  static void build_chunks(const ID *const boundaries,
+                           colle::DiscreteArray<T> &array, Func f) {
+    std::vector<std::pair<T *, u64>> chunks(loop::num_threads);
+    loop::parallel_each_thread(boundaries, [&](u32 thread_id, u32 numa_id,
+                                               ID lower, ID upper) {
+      chunks[thread_id] = f(thread_id, numa_id, lower, upper);
+    });
+    for (const auto &chunk : chunks) {
+      array.add(chunk.first, chunk.second);
+      array.own(chunk.first, chunk.second);
+    }
+  }
+
+  // work of a vertex (apply, v_data) in units of the work of an edge
+  static constexpr u64 VERTEX_COST = 4;
+
+  /*
+   * [#threads + 1] boundaries balancing VERTEX_COST per vertex plus its
+   * edges in `out_offsets` and `in_offsets` ([#vertices + 1] each, nullptr
+   * for a direction not walked). vertices are split across NUMA nodes first,
+   * in proportion to their threads, then across the threads of each node
+   */
+  static ID *partition(const u64 num_vertices, const ID *const out_offsets,
+                       const ID *const in_offsets) {
+    const auto cost = [&](const u64 v) {
+      return VERTEX_COST * v + (out_offsets != nullptr ? out_offsets[v] : 0) +
+             (in_offsets != nullptr ? in_offsets[v] : 0);
+    };
+    // the first vertex in [lower, upper] whose cost reaches `target`
+    const auto split = [&](u64 lower, u64 upper, const u64 target) {
+      while (lower < upper) {
+        const auto mid = (lower + upper) / 2;
+        if (cost(mid) < target) {
+          lower = mid + 1;
+        } else {
+          upper = mid;
+        }
+      }
+      return static_cast<ID>(lower);
+    };
+
+    const auto boundaries = mem::calloc<ID>(loop::num_threads + 1);
+    const auto total = cost(num_vertices);
+    u64 node_lower = 0;
+    // threads of a NUMA node are numbered contiguously
+    for (u32 head = 0, tail; head < loop::num_threads; head = tail) {
+      tail = head + 1;
+      while (tail < loop::num_threads &&
+             mock::thread_to_numa(tail) == mock::thread_to_numa(head)) {
+        tail++;
+      }
+      const u64 node_upper =
+          tail == loop::num_threads
+              ? num_vertices
+              : split(node_lower, num_vertices,
+                      total * tail / loop::num_threads);
+      const auto base = cost(node_lower);
+      const auto node_cost = cost(node_upper) - base;
+      for (auto thread_id = head + 1; thread_id < tail; ++thread_id) {
+        boundaries[thread_id] =
+            split(node_lower, node_upper,
+                  base + node_cost * (thread_id - head) / (tail - head));
+      }
+      boundaries[tail] = static_cast<ID>(node_upper);
+      node_lower = node_upper;
+    }
+    return boundaries;
+  }
+
+  /*
+   * a single owner thread of each vertex for both directions, so that
+   * v_data of a vertex is in the chunk of the thread walking its in- and
+   * out-edges. `in_offsets` is read by a directed graph walking in-edges
+   */
+  void set_boundaries(const ID *const in_offsets) {
+    assert(!out_offsets_is_initialized && !in_offsets_is_initialized);
+
+    const u64 length = num_threads + 1;
+    owned_boundaries.reset(
+        partition(num_vertices, has_out_edges() ? tmp_out_offsets : nullptr,
+                  !has_in_edges() ? nullptr
+                                  : IsDirected ? in_offsets : tmp_out_offsets),
+        [length](ID *boundaries) {
+          mem::free(boundaries, sizeof(ID) * length);
+        });
+    out_boundaries = owned_boundaries.get();
+    in_boundaries = out_boundaries;
+    out_boundaries_is_initialized = true;
+    in_boundaries_is_initialized = true;
+  }
+
+  /*
+   * in-edge offsets counted by `count(thread_id, counts)` for set_boundaries
+   * of a directed graph walking in-edges, nullptr otherwise
+   */
+  template <class Count /*(thread_id, counts)*/>
+  ID *count_in_offsets(Count count) const {
+    if (!IsDirected || !has_in_edges()) {
+      return nullptr;
+    }
+    std::unique_ptr<std::atomic<ID>[]> counts(
+        new std::atomic<ID>[num_vertices + 1]);
+    return count_offsets(num_vertices, counts.get(), count);
+  }
+
+  void free_offsets(ID *const offsets) const {
+    if (offsets != nullptr) {
+      mem::free(offsets, sizeof(ID) * (num_vertices + 1ul));
+    }
   }
 
   void set_out_offsets() {
     assert(out_boundaries_is_initialized);
 
-    loop::each_thread(out_boundaries, [&](u32 thread_id, u32 numa_id, ID lower,
-                                          ID upper /*, ID acc_num_srcs*/) {
+    build_chunks(out_boundaries, out_offsets, [&](u32 thread_id, u32 numa_id,
+                                                ID lower, ID upper) {
       const auto length = upper - lower + 1; // w/ cap
       const auto offsets = mem::malloc<ID>(length, numa_id);
       std::memcpy(offsets, tmp_out_offsets + lower, length * sizeof(ID));
@@ -193,18 +510,18 @@ struct Graph {
       //  }
       //}
 
-      out_offsets.add(offsets, length - 1); // real size w/o cap
+      return std::make_pair(offsets, length - 1); // real size w/o cap
     });
 
-    mem::free(tmp_out_offsets, sizeof(ID) * num_vertices);
+    free_offsets(tmp_out_offsets);
     out_offsets_is_initialized = true;
   }
 
   void set_in_offsets() {
     assert(in_boundaries_is_initialized);
 
-    loop::each_thread(in_boundaries, [&](u32 thread_id, u32 numa_id, ID lower,
-                                         ID upper /*, ID acc_num_srcs*/) {
+    build_chunks(in_boundaries, in_offsets, [&](u32 thread_id, u32 numa_id,
+                                                ID lower, ID upper) {
       const auto length = upper - lower + 1; // w/ cap
       const auto offsets = mem::malloc<ID>(length, numa_id);
       std::memcpy(offsets, tmp_in_offsets + lower, length * sizeof(ID));
@@ -217,56 +534,20 @@ struct Graph {
       //  }
       //}
 
-      in_offsets.add(offsets, length - 1); // real size w/o cap
+      return std::make_pair(offsets, length - 1); // real size w/o cap
     });
 
-    mem::free(tmp_in_offsets, sizeof(ID) * num_vertices);
+    free_offsets(tmp_in_offsets);
     in_offsets_is_initialized = true;
   }
 
-  void set_out_degrees() {
-    assert(out_boundaries_is_initialized);
-    assert(out_offsets_is_initialized);
-
-    loop::each_thread(out_boundaries, [&](u32 thread_id, u32 numa_id, u32 lower,
-                                          ID upper /*, ID acc_num_srcs*/) {
-      const auto length = upper - lower;
-      const auto degrees = mem::malloc<ID>(length, numa_id);
-      for (u32 i = lower; i < upper; ++i) {
-        degrees[i - lower] =
-            out_offsets(i + 1, thread_id) - out_offsets(i, thread_id);
-      }
-      out_degrees.add(degrees, length);
-    });
-
-    out_degrees_is_initialized = true;
-  }
-
-  void set_in_degrees() {
-    assert(in_boundaries_is_initialized);
-    assert(in_offsets_is_initialized);
-
-    loop::each_thread(in_boundaries, [&](u32 thread_id, u32 numa_id, u32 lower,
-                                         ID upper /*, ID acc_num_srcs*/) {
-      const auto length = upper - lower;
-      const auto degrees = mem::malloc<ID>(length, numa_id);
-      for (u32 i = lower; i < upper; ++i) {
-        degrees[i - lower] =
-            in_offsets(i + 1, thread_id) - in_offsets(i, thread_id);
-      }
-      in_degrees.add(degrees, length);
-    });
-
-    in_degrees_is_initialized = true;
-  }
-
   void set_out_indices() {
     assert(out_boundaries_is_initialized);
     assert(out_offsets_is_initialized);
 
     // const auto *_tmp_out_indices = tmp_out_indices;
-    loop::each_thread(out_boundaries, [&](u32 thread_id, u32 numa_id, ID lower,
-                                          ID upper /*, ID acc_num_srcs*/) {
+    build_chunks(out_boundaries, out_indices, [&](u32 thread_id, u32 numa_id,
+                                                ID lower, ID upper) {
       const auto start = out_offsets(lower, thread_id);
       const auto end = out_offsets(upper, thread_id, 0);
       // const auto num_srcs = upper - lower;
@@ -280,11 +561,11 @@ struct Graph {
       const auto indices = mem::calloc<ID>(num_nghs, numa_id);
       std::memcpy(indices, tmp_out_indices + start, num_nghs * sizeof(ID));
 
-      out_indices.add(indices, num_nghs);
+      return std::make_pair(indices, num_nghs);
       //_tmp_out_indices += end;
     });
 
-    mem::free(tmp_out_indices, num_edges);
+    mem::free(tmp_out_indices, sizeof(ID) * num_edges);
     out_indices_is_initialized = true;
   }
 
@@ -293,8 +574,8 @@ struct Graph {
     assert(in_offsets_is_initialized);
 
     // const auto *_tmp_in_indices = tmp_in_indices;
-    loop::each_thread(in_boundaries, [&](u32 thread_id, u32 numa_id, ID lower,
-                                         ID upper /*, ID acc_num_srcs*/) {
+    build_chunks(in_boundaries, in_indices, [&](u32 thread_id, u32 numa_id,
+                                                ID lower, ID upper) {
       const auto start = in_offsets(lower, thread_id);
       const auto end = in_offsets(upper, thread_id, 0);
       // const auto num_dsts = upper - lower;
@@ -307,316 +588,938 @@ struct Graph {
       const auto indices = mem::calloc<ID>(num_nghs, numa_id);
       std::memcpy(indices, tmp_in_indices + start, num_nghs * sizeof(ID));
 
-      in_indices.add(indices, end - start);
+      return std::make_pair(indices, end - start);
       //_tmp_in_indices += end;
     });
 
-    mem::free(tmp_in_indices, num_edges);
+    mem::free(tmp_in_indices, sizeof(ID) * num_edges);
     in_indices_is_initialized = true;
   }
 
-  void set_out_neighbor() {
-    assert(out_indices_is_initialized);
+  // `tmp_e_props` is in out-edge order
+  void set_out_e_props(_EPropColumn *tmp_e_props) {
     assert(out_offsets_is_initialized);
 
-    loop::each_thread(
-        out_boundaries, [&](u32 thread_id, u32 numa_id, u32 lower, u32 upper) {
-          auto out_neighbor = colle::make_numa_vector<ID *>(numa_id);
-          out_neighbor->reserve(upper - lower);
-          for (ID i = lower; i < upper; ++i) {
-            out_neighbor->emplace_back(
-                &out_indices(out_offsets(i, thread_id), thread_id));
-          }
-          out_neighbors.add(std::move(*out_neighbor));
-        });
-
-    // out_neighbors_is_initialized = true;
-  }
-
-  void set_in_neighbor() {
-    assert(in_indices_is_initialized);
-    assert(in_offsets_is_initialized);
-
-    loop::each_thread(
-        in_boundaries, [&](u32 thread_id, u32 numa_id, u32 lower, u32 upper) {
-          auto in_neighbor = colle::make_numa_vector<ID *>(numa_id);
-          in_neighbor->reserve(upper - lower);
-          for (ID i = lower; i < upper; ++i) {
-            in_neighbor->emplace_back(
-                &in_indices(in_offsets(i, thread_id), thread_id));
-          }
-          in_neighbors.add(std::move(*in_neighbor));
-        });
+    build_chunks(out_boundaries, out_e_props, [&](u32 thread_id, u32 numa_id,
+                                                  ID lower, ID upper) {
+      const auto start = out_offsets(lower, thread_id);
+      const auto end = out_offsets(upper, thread_id, 0);
+      const auto num_nghs = end - start;
+      const auto e_props = mem::malloc<_EPropColumn>(num_nghs, numa_id);
+      std::memcpy(e_props, tmp_e_props + start,
+                  num_nghs * sizeof(_EPropColumn));
+      return std::make_pair(e_props, num_nghs);
+    });
 
-    // in_neighbors_is_initialized = true;
+    mem::free(tmp_e_props, sizeof(_EPropColumn) * num_edges);
   }
 
+  // position of each out-edge among in-edges. in-lists are sorted by source,
+  // so it is found by a binary search in the in-list of the destination and
+  // each thread fills the chunk of its own out-edges. in an undirected graph
+  // it is the slot of the reverse edge in the same CSR
   void set_forward_indices() {
     assert(out_boundaries_is_initialized);
     assert(out_offsets_is_initialized);
-    assert(out_degrees_is_initialized);
     assert(out_indices_is_initialized);
     assert(in_offsets_is_initialized);
+    assert(in_indices_is_initialized);
 
-    forward_indices = mem::malloc<ID>(num_edges); // TODO: should be numa-local
-
-    auto counts = std::vector<ID>(num_vertices, 0);
-    // loop::each_index(
-    //    out_boundaries, out_indices, out_offsets,
-    //    [&](u32 thread_id, u32 numa_id, ID dst, ID local_offset, ID
-    //    global_idx,
-    //        ID local_idx, ID global_offset) {
-    //      forward_indices[global_offset + local_offset + local_idx] =
-    //          in_offsets(dst) + counts[dst];
-    //      counts[dst]++;
-    //    });
-
-    loop::each_thread(
-        out_boundaries, [&](u32 thread_id, u32 numa_id, u32 lower, u32 upper) {
-          for (ID src = lower; src < upper; ++src) {
-            const auto neighbor = out_neighbors(src, thread_id);
-            for (ID i = 0, end = out_degrees(src, thread_id); i < end; ++i) {
-              const auto dst = neighbor[i];
-              forward_indices[out_offsets(src, thread_id) + i] =
-                  in_offsets(dst) + counts[dst];
-              counts[dst]++;
-            }
-          }
-        });
+    build_chunks(out_boundaries, forward_indices, [&](u32 thread_id,
+                                                      u32 numa_id, ID lower,
+                                                      ID upper) {
+      const auto start = out_offsets(lower, thread_id, 0);
+      const auto end = out_offsets(upper, thread_id, 0);
+      const auto forward = mem::malloc<ID>(end - start, numa_id);
+      for (ID src = lower; src < upper; ++src) {
+        const auto neighbor = out_neighbors(src, thread_id);
+        const auto offset = out_offsets(src, thread_id, 0) - start;
+        ID num_duplicates = 0;
+        for (ID i = 0, degree = out_degree(src, thread_id); i < degree; ++i) {
+          const auto dst = neighbor[i];
+          // out-lists are sorted too, so duplicated edges are adjacent
+          num_duplicates =
+              i > 0 && neighbor[i - 1] == dst ? num_duplicates + 1 : 0;
+          const auto n = in_offsets.chunk_of(dst);
+          const auto srcs = in_neighbors(dst, n);
+          const auto rank =
+              std::lower_bound(srcs, srcs + in_degree(dst, n), src) - srcs;
+          forward[offset + i] = in_offsets(dst, n, 0) + rank + num_duplicates;
+        }
+      }
+      return std::make_pair(forward, end - start);
+    });
 
     forward_indices_is_initialized = true;
   }
 
+  /*
+   * packs in-lists into in_compressed and drops in_indices (and out_indices
+   * of an undirected graph, the same lists), so that a pull over in-edges
+   * reads fewer bytes per edge. the lists are walked in order by
+   * each_in_neighbor, as in-only kernels do, or one by one through in_skips
+   */
+  void compress_in_indices() {
+    static_assert(sizeof(ID) == sizeof(u32), "lists are packed as u32");
+    assert(in_offsets_is_initialized && in_indices_is_initialized);
+
+    // (block, chunk, bytes of block, bytes of chunk). chunks start at 32-byte
+    // boundaries for aligned loads, blocks have room for it
+    std::vector<std::tuple<u8 *, u8 *, u64, u64>> chunks(num_threads);
+    std::vector<std::pair<u64 *, u32>> skips(num_threads);
+    loop::parallel_each_thread(in_boundaries, [&](u32 thread_id, u32 numa_id,
+                                                  ID lower, ID upper) {
+      const auto srcs = in_neighbors(lower, thread_id);
+      const auto offsets = in_offsets.data[thread_id]; // w/ cap
+      const auto size =
+          compress::multiple::estimate(srcs, offsets, upper - lower) + 31;
+      const auto block = mem::calloc<u8>(size, numa_id);
+      const auto chunk = reinterpret_cast<u8 *>(
+          (reinterpret_cast<uintptr_t>(block) + 31) / 32 * 32);
+      const auto num_skips = compress::multiple::num_skips(upper - lower);
+      const auto skip = mem::malloc<u64>(num_skips, numa_id);
+      const auto used = compress::multiple::encode(srcs, offsets,
+                                                   upper - lower, chunk, skip);
+      chunks[thread_id] = std::make_tuple(block, chunk, size, used);
+      skips[thread_id] = std::make_pair(skip, num_skips);
+    });
+    in_compressed.clear();
+    for (const auto &chunk : chunks) {
+      in_compressed.add(std::get<1>(chunk), std::get<3>(chunk));
+      in_compressed.own(std::get<0>(chunk), std::get<2>(chunk));
+    }
+    in_skips.clear();
+    for (const auto &skip : skips) {
+      in_skips.add(skip.first, skip.second);
+      in_skips.own(skip.first, skip.second);
+    }
+
+    in_indices.clear();
+    in_indices_is_initialized = false;
+    if (!IsDirected) {
+      out_indices.clear();
+      out_indices_is_initialized = false;
+    }
+    in_indices_is_compressed = true;
+    debug::logger->info("compressed in-edges: {} -> {} bytes (+{} of skips)",
+                        sizeof(ID) * num_edges, in_compressed.bytes(),
+                        in_skips.bytes());
+  }
+
+  // previous v_data, if any, is freed
   void set_v_data(bool allow_overwrite = false) {
+    v_data = alloc_v_data();
+  }
+
+  // chunks shaped as v_data, e.g. for the other half of a double buffer
+  colle::DiscreteArray<VData> alloc_v_data() const {
     assert(out_boundaries_is_initialized);
     // assert(in_boundaries_is_initialized);
 
-    if (allow_overwrite) {
-      v_data = *(new colle::DiscreteArray<VData>());
-    }
-
     // TODO: consider both out and in boundaries (?)
     // If readonly, it should be allowed that duplicate vertex data
     // And should be allocated on each numa node
-    loop::each_thread(out_boundaries, [&](u32 thread_id, u32 numa_id, ID lower,
-                                          ID upper /*, ID acc_num_srcs*/) {
+    // on a single node, chunks are slices of one block so that the results
+    // can be handed out as a single array without a copy
+    colle::DiscreteArray<VData> values;
+    if (loop::num_numa_nodes == 1) {
+      const auto block = mem::malloc<VData>(num_vertices, 0);
+      values.own(block, num_vertices);
+      loop::each_thread(out_boundaries, [&](u32 thread_id, u32 numa_id,
+                                            ID lower, ID upper) {
+        values.add(block + lower, upper - lower);
+      });
+      return values;
+    }
+    build_chunks(out_boundaries, values, [&](u32 thread_id, u32 numa_id,
+                                             ID lower, ID upper) {
       const auto num_inner_vertices = upper - lower;
-      v_data.add(mem::malloc<VData>(num_inner_vertices, numa_id),
-                 num_inner_vertices);
+      return std::make_pair(mem::malloc<VData>(num_inner_vertices, numa_id),
+                            num_inner_vertices);
     });
+    return values;
   }
 
+  // previous e_data, if any, is freed
   void set_e_data(bool allow_overwirte = false) {
-    assert(out_boundaries_is_initialized);
-    assert(out_offsets_is_initialized);
-    // assert(in_boundaries_is_initialized);
-    // assert(in_offsets_is_initialized);
+    assert(in_boundaries_is_initialized);
+    assert(in_offsets_is_initialized);
 
-    if (allow_overwirte) {
-      e_data = *(new colle::DiscreteArray<EData>());
-    }
+    e_data.clear();
 
-    // TODO: consider both out and in boundaries (?)
+    // e_data is indexed by in-edges (see forward_indices), so each thread
+    // sums over its own chunk
     // If readonly, it should be allowed that duplicate edge data
     // And should be allocated on each numa node
-    loop::each_thread(out_boundaries, [&](u32 thread_id, u32 numa_id, ID lower,
-                                          ID upper /*, ID acc_num_srcs*/) {
-      const auto start = out_offsets(lower, thread_id);
-      const auto end = out_offsets(upper, thread_id);
+    build_chunks(in_boundaries, e_data, [&](u32 thread_id, u32 numa_id,
+                                            ID lower, ID upper) {
+      const auto start = in_offsets(lower, thread_id);
+      const auto end = in_offsets(upper, thread_id);
       const auto num_inner_edges = end - start;
-      e_data.add(mem::malloc<EData>(num_inner_edges, numa_id), num_inner_edges);
+      return std::make_pair(mem::malloc<EData>(num_inner_edges, numa_id),
+                            num_inner_edges);
     });
   }
 
+  // writes boundaries, offsets, indices and forward_indices as they are, so
+  // that `open` can map them without any conversion
+  void save(const std::string &file_name, const u64 source_size = 0,
+            const i64 source_mtime = 0, const u64 format = 0) const {
+    assert(out_offsets_is_initialized && out_indices_is_initialized);
+    assert(in_offsets_is_initialized && in_indices_is_initialized);
+    assert(forward_indices_is_initialized);
+    assert(direction == Direction::Both);
+
+    const u64 boundaries_size = sizeof(ID) * (num_threads + 1);
+    const u64 offsets_size = sizeof(ID) * (num_vertices + 1ul);
+    const u64 indices_size = sizeof(ID) * num_edges;
+
+    snapshot::Header header{};
+    std::memcpy(header.magic, snapshot::MAGIC, sizeof(snapshot::MAGIC));
+    header.version = snapshot::VERSION;
+    header.id_size = sizeof(ID);
+    header.num_vertices = num_vertices;
+    header.num_edges = num_edges;
+    header.num_threads = num_threads;
+    header.flags = snapshot_flags(cleanup, reordering);
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+    header.format = format;
+
+    auto pos = snapshot::align(sizeof(snapshot::Header));
+    const auto place = [&pos](const u64 size) {
+      const auto head = pos;
+      pos = snapshot::align(pos + size);
+      return head;
+    };
+    header.out_boundaries = place(boundaries_size);
+    header.in_boundaries = header.out_boundaries;
+    header.out_offsets = place(offsets_size);
+    header.out_indices = place(indices_size);
+    if (IsDirected) {
+      header.in_offsets = place(offsets_size);
+      header.in_indices = place(indices_size);
+    } else {
+      // the in-sections are the out-sections
+      header.in_offsets = header.out_offsets;
+      header.in_indices = header.out_indices;
+    }
+    header.forward_indices = place(indices_size);
+    header.num_external_ids = external_ids.size();
+    header.external_ids = place(sizeof(u64) * external_ids.size());
+    const bool has_e_props = !out_e_props.data.empty();
+    header.e_prop_size = has_e_props ? sizeof(_EPropColumn) : 0;
+    header.out_e_props = place(header.e_prop_size * num_edges);
+    header.file_size = pos;
+
+    const auto write_chunks = [](snapshot::Writer &writer,
+                                 const auto &array) {
+      for (u32 n = 0; n < array.data.size(); ++n) {
+        writer.write(array.data[n], sizeof(*array.data[n]) *
+                                        (array.range[n + 1] - array.range[n]));
+      }
+    };
+    const ID cap = num_edges;
+
+    snapshot::Writer writer(file_name);
+    writer.write(&header, sizeof(header));
+    writer.pad();
+    writer.write(out_boundaries, boundaries_size);
+    writer.pad();
+    write_chunks(writer, out_offsets);
+    writer.write(&cap, sizeof(ID));
+    writer.pad();
+    write_chunks(writer, out_indices);
+    writer.pad();
+    if (IsDirected) {
+      write_chunks(writer, in_offsets);
+      writer.write(&cap, sizeof(ID));
+      writer.pad();
+      write_chunks(writer, in_indices);
+      writer.pad();
+    }
+    write_chunks(writer, forward_indices);
+    writer.pad();
+    writer.write(external_ids.data(), sizeof(u64) * external_ids.size());
+    writer.pad();
+    if (has_e_props) {
+      write_chunks(writer, out_e_props);
+    }
+    writer.pad();
+    assert(writer.pos == header.file_size);
+    writer.commit();
+  }
+
+  static u32 snapshot_flags(const Cleanup &cleanup,
+                            const Reordering reordering) {
+    return (IsDirected ? 0 : snapshot::UNDIRECTED) |
+           (cleanup.duplicates ? snapshot::NO_DUPLICATES : 0) |
+           (cleanup.self_loops ? snapshot::NO_SELF_LOOPS : 0) |
+           static_cast<u32>(reordering) << snapshot::REORDERING_SHIFT;
+  }
+
+  // maps a snapshot written by `save`. topology arrays are not copied but
+  // point into the mapping, only boundaries are recomputed if #threads
+  // differs.
+  // sections `direction` does not ask for are left unmapped in the Graph
+  static _Graph open(const std::string &file_name,
+                     const Direction direction = Direction::Both) {
+    const auto file = std::make_shared<MappedFile>(file_name, true);
+    if (file->size < sizeof(snapshot::Header)) {
+      throw std::runtime_error("Broken snapshot " + file_name);
+    }
+    const auto &header =
+        *reinterpret_cast<const snapshot::Header *>(file->data);
+    if (!snapshot::is_valid(header, sizeof(ID), IsDirected) ||
+        header.file_size != file->size) {
+      throw std::runtime_error("Incompatible snapshot " + file_name);
+    }
+    const auto section = [&file](const u64 pos) {
+      return reinterpret_cast<ID *>(file->data + pos);
+    };
+
+    auto g = _Graph();
+    g.direction = direction;
+    g.cleanup.duplicates = (header.flags & snapshot::NO_DUPLICATES) != 0;
+    g.cleanup.self_loops = (header.flags & snapshot::NO_SELF_LOOPS) != 0;
+    g.reordering =
+        static_cast<Reordering>(header.flags >> snapshot::REORDERING_SHIFT);
+    g.snapshot_file = file;
+    g.num_vertices = static_cast<ID>(header.num_vertices);
+    g.num_edges = static_cast<ID>(header.num_edges);
+    g.tmp_out_offsets = section(header.out_offsets);
+    g.tmp_in_offsets = section(header.in_offsets);
+    const auto external_ids =
+        reinterpret_cast<const u64 *>(file->data + header.external_ids);
+    g.external_ids.assign(external_ids,
+                          external_ids + header.num_external_ids);
+    if (g.reordering != Reordering::None) {
+      g.set_internal_ids();
+    }
+
+    if (header.num_threads == g.num_threads) {
+      g.out_boundaries = section(header.out_boundaries);
+      g.in_boundaries = g.out_boundaries;
+      g.out_boundaries_is_initialized = true;
+      g.in_boundaries_is_initialized = true;
+    } else {
+      g.set_boundaries(g.tmp_in_offsets);
+    }
+    const auto out_indices = section(header.out_indices);
+    const auto forward_indices = section(header.forward_indices);
+    loop::each_thread(g.out_boundaries, [&](u32 thread_id, u32 numa_id,
+                                            ID lower, ID upper) {
+      const auto offsets = g.tmp_out_offsets;
+      g.out_offsets.add(offsets + lower, upper - lower);
+      if (g.has_out_edges()) {
+        g.out_indices.add(out_indices + offsets[lower],
+                          offsets[upper] - offsets[lower]);
+      }
+      if (direction == Direction::Both) {
+        g.forward_indices.add(forward_indices + offsets[lower],
+                              offsets[upper] - offsets[lower]);
+      }
+    });
+    if (g.has_out_edges() && header.e_prop_size == sizeof(_EPropColumn)) {
+      const auto out_e_props =
+          reinterpret_cast<_EPropColumn *>(file->data + header.out_e_props);
+      loop::each_thread(g.out_boundaries, [&](u32 thread_id, u32 numa_id,
+                                              ID lower, ID upper) {
+        const auto offsets = g.tmp_out_offsets;
+        g.out_e_props.add(out_e_props + offsets[lower],
+                          offsets[upper] - offsets[lower]);
+      });
+    }
+    if (!IsDirected) {
+      g.out_offsets_is_initialized = true;
+      g.out_indices_is_initialized = true;
+      g.share_in_with_out();
+      g.set_v_data();
+      if (direction == Direction::Both) {
+        g.forward_indices_is_initialized = true;
+        g.set_e_data();
+      }
+      return g;
+    }
+    const auto in_indices = section(header.in_indices);
+    loop::each_thread(g.in_boundaries, [&](u32 thread_id, u32 numa_id,
+                                           ID lower, ID upper) {
+      const auto offsets = g.tmp_in_offsets;
+      g.in_offsets.add(offsets + lower, upper - lower);
+      if (g.has_in_edges()) {
+        g.in_indices.add(in_indices + offsets[lower],
+                         offsets[upper] - offsets[lower]);
+      }
+    });
+    g.out_offsets_is_initialized = true;
+    g.in_offsets_is_initialized = true;
+
+    g.out_indices_is_initialized = g.has_out_edges();
+    g.in_indices_is_initialized = g.has_in_edges();
+    g.set_v_data();
+    if (direction == Direction::Both) {
+      g.forward_indices_is_initialized = true;
+      g.set_e_data();
+    }
+
+    return g;
+  }
+
   static void next(_Graph &prev, _Graph &curr) {
     // TODO
     std::swap(prev.v_data, curr.v_data);
     std::swap(prev.e_data, curr.e_data);
   }
 
-  // TODO: Poor performance
-  // *require packed index* (process in pre-processing)
-  static _Graph from_edge_list(std::vector<std::pair<ID, ID>> &edge_list) {
+  /*
+   * out- and in-CSR by counting sort: degrees are counted into a histogram
+   * in parallel, edges are scattered straight into the per-thread chunks and
+   * each list is sorted in place, so no intermediate copy is made.
+   * in-only graphs scatter sources by destination without any out-list,
+   * undirected ones scatter each edge into the lists of both ends.
+   * *require packed index* (process in pre-processing)
+   */
+  static _Graph
+  from_edge_list(const std::vector<std::pair<ID, ID>> &edge_list,
+                 const Direction direction = Direction::Both,
+                 const Cleanup &cleanup = Cleanup()) {
     assert(!edge_list.empty());
 
-    using VVType = std::pair<ID, ID>;
-
-    // outbound
-    std::sort(
-        begin(edge_list), end(edge_list),
-        [](const VVType &l, const VVType &r) { return l.second < r.second; });
-    auto tmp_max = edge_list.back().second;
-    std::stable_sort(
-        begin(edge_list), end(edge_list),
-        [](const VVType &l, const VVType &r) { return l.first < r.first; });
-
-    auto num_vertices =
-        std::max(tmp_max, edge_list.back().first) + 1; // 0-based
-    auto num_edges = edge_list.size();
-
-    auto out_offsets = mem::malloc<ID>(num_vertices + 1); // all vertices + cap
-    auto out_indices = mem::malloc<ID>(num_edges);        // all edges
-
-    out_offsets[0] = 0u;
-    auto prev_src = edge_list[0].first;
-    for (u32 i = 1; i <= prev_src; ++i) {
-      out_offsets[i] = 0;
-    }
-    for (u32 i = 0; i < num_edges; ++i) {
-      auto curr = edge_list[i];
-      // next source vertex
-      if (prev_src != curr.first) {
-        // loop for vertices whose degree is 0
-        for (auto j = prev_src + 1; j <= curr.first; ++j) {
-          out_offsets[j] = i;
+    const u64 num_edges = edge_list.size();
+    std::vector<ID> max_ids(loop::num_threads, 0);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto lower = num_edges * thread_id / loop::num_threads;
+      const auto upper = num_edges * (thread_id + 1) / loop::num_threads;
+      for (u64 i = lower; i < upper; ++i) {
+        max_ids[thread_id] = std::max(
+            max_ids[thread_id], std::max(edge_list[i].first, edge_list[i].second));
+      }
+    });
+    const u64 num_vertices =
+        *std::max_element(max_ids.begin(), max_ids.end()) + 1; // 0-based
+
+    auto g = _Graph();
+    g.direction = direction;
+    g.cleanup = cleanup;
+    g.num_vertices = num_vertices;
+
+    std::unique_ptr<std::atomic<ID>[]> cursors(
+        new std::atomic<ID>[num_vertices + 1]);
+    const auto in_offsets =
+        g.count_in_offsets([&](u32 thread_id, std::atomic<ID> *counts) {
+          const auto lower = num_edges * thread_id / loop::num_threads;
+          const auto upper = num_edges * (thread_id + 1) / loop::num_threads;
+          for (u64 i = lower; i < upper; ++i) {
+            counts[edge_list[i].second + 1].fetch_add(
+                1, std::memory_order_relaxed);
+          }
+        });
+    g.tmp_out_offsets = count_offsets(
+        num_vertices, cursors.get(),
+        [&](u32 thread_id, std::atomic<ID> *counts) {
+          const auto lower = num_edges * thread_id / loop::num_threads;
+          const auto upper = num_edges * (thread_id + 1) / loop::num_threads;
+          for (u64 i = lower; i < upper; ++i) {
+            const auto &edge = edge_list[i];
+            counts[edge.first + 1].fetch_add(1, std::memory_order_relaxed);
+            if (!IsDirected && edge.first != edge.second) {
+              counts[edge.second + 1].fetch_add(1, std::memory_order_relaxed);
+            }
+          }
+        });
+    g.num_edges = g.tmp_out_offsets[num_vertices];
+    g.set_boundaries(in_offsets);
+    g.set_out_offsets();
+
+    // out-degrees are counted before cleanup, which then needs out-lists
+    if (!g.has_out_edges() && !cleanup.any()) {
+      g.tmp_in_offsets = in_offsets;
+      loop::fork_join([&](u32 thread_id, u32 numa_id) {
+        const auto lower = (num_vertices + 1) * thread_id / loop::num_threads;
+        const auto upper =
+            (num_vertices + 1) * (thread_id + 1) / loop::num_threads;
+        for (u64 v = lower; v < upper; ++v) {
+          cursors[v].store(in_offsets[v], std::memory_order_relaxed);
+        }
+      });
+      g.set_in_offsets();
+      alloc_indices(g.in_boundaries, g.in_offsets, g.in_indices);
+      loop::fork_join([&](u32 thread_id, u32 numa_id) {
+        const auto lower = num_edges * thread_id / loop::num_threads;
+        const auto upper = num_edges * (thread_id + 1) / loop::num_threads;
+        for (u64 i = lower; i < upper; ++i) {
+          scatter(g.in_boundaries, g.in_indices, cursors.get(),
+                  edge_list[i].second, edge_list[i].first);
+        }
+      });
+      cursors.reset();
+      sort_lists(g.in_boundaries, g.in_offsets, g.in_indices);
+      g.in_indices_is_initialized = true;
+
+      g.set_v_data();
+      return g;
+    }
+
+    g.free_offsets(in_offsets); // recounted after cleanup
+    alloc_indices(g.out_boundaries, g.out_offsets, g.out_indices);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto lower = num_edges * thread_id / loop::num_threads;
+      const auto upper = num_edges * (thread_id + 1) / loop::num_threads;
+      for (u64 i = lower; i < upper; ++i) {
+        const auto &edge = edge_list[i];
+        scatter(g.out_boundaries, g.out_indices, cursors.get(), edge.first,
+                edge.second);
+        if (!IsDirected && edge.first != edge.second) {
+          scatter(g.out_boundaries, g.out_indices, cursors.get(), edge.second,
+                  edge.first);
         }
-        prev_src = curr.first;
       }
-      out_indices[i] = curr.second;
+    });
+    cursors.reset();
+    g.set_rest_from_out();
+
+    return g;
+  }
+
+  /*
+   * builds everything `direction` asks for from out-lists copied into
+   * out_indices. an in-only graph uses them for the transpose and frees them
+   */
+  void set_rest_from_out() {
+    assert(out_offsets_is_initialized);
+
+    if (has_out_edges() || cleanup.any()) {
+      sort_lists(out_boundaries, out_offsets, out_indices);
     }
-    for (auto i = prev_src + 1; i <= num_vertices; ++i) {
-      out_offsets[i] = num_edges;
+    if (cleanup.any()) {
+      num_edges = clean_lists(cleanup, out_boundaries, out_offsets,
+                              out_indices);
     }
+    out_indices_is_initialized = true;
 
-    // and vice versa (inbound)
-    for (auto &p : edge_list) {
-      std::swap(p.first, p.second);
+    if (!IsDirected) {
+      share_in_with_out();
+    } else {
+      if (has_in_edges()) {
+        set_in_from_out();
+      }
+      if (!has_out_edges()) {
+        out_indices.clear();
+        out_indices_is_initialized = false;
+      }
+    }
+    if (direction == Direction::Both) {
+      set_forward_indices();
+      set_e_data();
     }
-    std::sort(
-        begin(edge_list), end(edge_list),
-        [](const VVType &l, const VVType &r) { return l.second < r.second; });
-    std::stable_sort(
-        begin(edge_list), end(edge_list),
-        [](const VVType &l, const VVType &r) { return l.first < r.first; });
+    set_v_data();
+
+    assert(out_offsets_is_initialized);
+    assert(out_boundaries_is_initialized);
+    assert(out_indices_is_initialized == has_out_edges());
+    assert(in_indices_is_initialized == has_in_edges());
+    assert(forward_indices_is_initialized ==
+           (direction == Direction::Both));
+  }
+
+  /*
+   * [#vertices + 1] offsets from degrees counted by `count(thread_id, counts)`
+   * on every thread, which increments counts[v + 1] per edge of v. `counts`
+   * ([#vertices + 1]) is left as the first slot of each vertex to scatter to
+   */
+  template <class Count /*(thread_id, counts)*/>
+  static ID *count_offsets(const u64 num_vertices, std::atomic<ID> *counts,
+                           Count count) {
+    const auto length = num_vertices + 1;
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto lower = length * thread_id / loop::num_threads;
+      const auto upper = length * (thread_id + 1) / loop::num_threads;
+      for (u64 v = lower; v < upper; ++v) {
+        counts[v].store(0, std::memory_order_relaxed);
+      }
+    });
+    loop::fork_join(
+        [&](u32 thread_id, u32 numa_id) { count(thread_id, counts); });
+
+    // inclusive scan of shifted degrees, sums of slices first
+    const auto offsets = mem::malloc<ID>(length);
+    std::vector<ID> sums(loop::num_threads + 1, 0);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto lower = length * thread_id / loop::num_threads;
+      const auto upper = length * (thread_id + 1) / loop::num_threads;
+      for (u64 v = lower; v < upper; ++v) {
+        sums[thread_id + 1] += counts[v].load(std::memory_order_relaxed);
+      }
+    });
+    for (u32 thread_id = 0; thread_id < loop::num_threads; ++thread_id) {
+      sums[thread_id + 1] += sums[thread_id];
+    }
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto lower = length * thread_id / loop::num_threads;
+      const auto upper = length * (thread_id + 1) / loop::num_threads;
+      auto sum = sums[thread_id];
+      for (u64 v = lower; v < upper; ++v) {
+        sum += counts[v].load(std::memory_order_relaxed);
+        offsets[v] = sum;
+        counts[v].store(sum, std::memory_order_relaxed);
+      }
+    });
+    return offsets;
+  }
 
-    auto in_offsets = mem::malloc<ID>(num_vertices);
-    auto in_indices = mem::malloc<ID>(num_edges);
+  // a chunk of `indices` per thread, sized by `offsets` of its vertices
+  static void alloc_indices(const ID *const boundaries,
+                            const colle::DiscreteArray<ID> &offsets,
+                            colle::DiscreteArray<ID> &indices) {
+    build_chunks(boundaries, indices, [&](u32 thread_id, u32 numa_id, ID lower,
+                                          ID upper) {
+      const auto start = offsets(lower, thread_id, 0);
+      const auto end = offsets(upper, thread_id, 0);
+      return std::make_pair(mem::malloc<ID>(end - start, numa_id), end - start);
+    });
+  }
+
+  // writes `value` to the next slot of `v` in the chunk of its thread
+  static inline void scatter(const ID *const boundaries,
+                             colle::DiscreteArray<ID> &indices,
+                             std::atomic<ID> *cursors, const ID v,
+                             const ID value) {
+    const auto n = static_cast<u32>(
+        std::upper_bound(boundaries + 1, boundaries + loop::num_threads + 1, v) -
+        (boundaries + 1));
+    const auto slot = cursors[v].fetch_add(1, std::memory_order_relaxed);
+    indices.data[n][slot - indices.range[n]] = value;
+  }
 
-    in_offsets[0] = 0;
-    prev_src = edge_list[0].first;
-    for (u32 i = 1; i <= prev_src; ++i) {
-      in_offsets[i] = 0;
+  /*
+   * drops repeats and/or self-loops from each sorted list in place, by the
+   * thread owning it. offsets and the ranges of `indices` are shifted to the
+   * kept edges, whose number is returned
+   */
+  static ID clean_lists(const Cleanup &cleanup, const ID *const boundaries,
+                        colle::DiscreteArray<ID> &offsets,
+                        colle::DiscreteArray<ID> &indices) {
+    std::vector<ID> kept(loop::num_threads + 1, 0);
+    std::vector<u64> duplicates(loop::num_threads, 0);
+    std::vector<u64> self_loops(loop::num_threads, 0);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto chunk = indices.data[thread_id];
+      const auto start = indices.range[thread_id];
+      const auto lower = boundaries[thread_id];
+      const auto upper = boundaries[thread_id + 1];
+      ID pos = 0;
+      auto last = offsets(lower, thread_id) - start;
+      for (auto v = lower; v < upper; ++v) {
+        const auto first = last; // offsets(v) is already overwritten
+        last = offsets(v + 1, thread_id) - start;
+        const auto head = pos;
+        offsets(v, thread_id) = head; // chunk-local until all are counted
+        for (auto i = first; i < last; ++i) {
+          const auto u = chunk[i];
+          if (cleanup.self_loops && u == v) {
+            self_loops[thread_id]++;
+          } else if (cleanup.duplicates && pos > head && chunk[pos - 1] == u) {
+            duplicates[thread_id]++;
+          } else {
+            chunk[pos++] = u;
+          }
+        }
+      }
+      offsets(upper, thread_id) = pos; // cap
+      kept[thread_id + 1] = pos;
+    });
+    for (u32 thread_id = 0; thread_id < loop::num_threads; ++thread_id) {
+      kept[thread_id + 1] += kept[thread_id];
+      indices.range[thread_id + 1] = kept[thread_id + 1];
     }
-    for (u32 i = 0; i < num_edges; ++i) {
-      auto curr = edge_list[i];
-      if (prev_src != curr.first) {
-        // loop for vertices whose degree is 0
-        for (auto j = prev_src + 1; j <= curr.first; ++j) {
-          in_offsets[j] = i;
+    indices.update_lookup();
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      for (auto v = boundaries[thread_id], end = boundaries[thread_id + 1];
+           v <= end; ++v) {
+        offsets(v, thread_id) += kept[thread_id];
+      }
+    });
+
+    debug::logger->info(
+        "removed {} duplicated edges and {} self-loops",
+        std::accumulate(duplicates.begin(), duplicates.end(), 0ul),
+        std::accumulate(self_loops.begin(), self_loops.end(), 0ul));
+    return kept[loop::num_threads];
+  }
+
+  // sorts each list in place by the thread owning its vertex
+  static void sort_lists(const ID *const boundaries,
+                         const colle::DiscreteArray<ID> &offsets,
+                         colle::DiscreteArray<ID> &indices) {
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto chunk = indices.data[thread_id] - indices.range[thread_id];
+      for (auto v = boundaries[thread_id], end = boundaries[thread_id + 1];
+           v < end; ++v) {
+        std::sort(chunk + offsets(v, thread_id, 0),
+                  chunk + offsets(v + 1, thread_id, 0));
+      }
+    });
+  }
+
+  // in-CSR by transposing the out-CSR, in-lists are sorted by source
+  void set_in_from_out() {
+    assert(out_offsets_is_initialized);
+    assert(out_indices_is_initialized);
+    assert(in_boundaries_is_initialized);
+
+    std::unique_ptr<std::atomic<ID>[]> cursors(
+        new std::atomic<ID>[num_vertices + 1]);
+    tmp_in_offsets = count_offsets(
+        num_vertices, cursors.get(),
+        [&](u32 thread_id, std::atomic<ID> *counts) {
+          const auto chunk = out_indices.data[thread_id];
+          for (u32 i = 0, end = out_indices.range[thread_id + 1] -
+                                out_indices.range[thread_id];
+               i < end; ++i) {
+            counts[chunk[i] + 1].fetch_add(1, std::memory_order_relaxed);
+          }
+        });
+    set_in_offsets();
+    alloc_indices(in_boundaries, in_offsets, in_indices);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto chunk = out_indices.data[thread_id] - out_indices.range[thread_id];
+      for (auto src = out_boundaries[thread_id],
+                end = out_boundaries[thread_id + 1];
+           src < end; ++src) {
+        for (auto i = out_offsets(src, thread_id, 0),
+                  last = out_offsets(src + 1, thread_id, 0);
+             i < last; ++i) {
+          scatter(in_boundaries, in_indices, cursors.get(), chunk[i], src);
         }
-        prev_src = curr.first;
       }
-      in_indices[i] = curr.second;
+    });
+    cursors.reset();
+    sort_lists(in_boundaries, in_offsets, in_indices);
+    in_indices_is_initialized = true;
+  }
+
+  /*
+   * builds from an out-CSR of `num_rows` rows (e.g. scipy.sparse.csr_matrix)
+   * without an intermediate edge list. indices are copied once into the
+   * per-thread chunks, in-edges are derived by set_in_from_out.
+   * rows after `num_rows` up to `num_vertices` have no out-edges.
+   * an undirected graph takes it as it is, so it must be symmetric already
+   */
+  template <class Offset, class Index>
+  static _Graph from_csr(const Offset *const offsets,
+                         const Index *const indices, const u64 num_rows,
+                         const u64 num_vertices,
+                         const Direction direction = Direction::Both,
+                         const Cleanup &cleanup = Cleanup()) {
+    assert(num_rows <= num_vertices);
+    const auto num_edges = static_cast<u64>(offsets[num_rows]);
+
+    auto g = _Graph();
+    g.direction = direction;
+    g.cleanup = cleanup;
+    g.num_vertices = static_cast<ID>(num_vertices);
+    g.num_edges = static_cast<ID>(num_edges);
+
+    g.tmp_out_offsets = mem::malloc<ID>(num_vertices + 1);
+    for (u64 v = 0; v <= num_vertices; ++v) {
+      g.tmp_out_offsets[v] =
+          static_cast<ID>(v <= num_rows ? offsets[v] : num_edges);
     }
-    for (auto i = prev_src + 1; i <= num_vertices; ++i) {
-      in_offsets[i] = num_edges;
+    const auto in_offsets =
+        g.count_in_offsets([&](u32 thread_id, std::atomic<ID> *counts) {
+          const auto lower = num_edges * thread_id / loop::num_threads;
+          const auto upper = num_edges * (thread_id + 1) / loop::num_threads;
+          for (u64 i = lower; i < upper; ++i) {
+            counts[indices[i] + 1].fetch_add(1, std::memory_order_relaxed);
+          }
+        });
+    g.set_boundaries(in_offsets);
+    g.free_offsets(in_offsets);
+    g.set_out_offsets();
+    alloc_indices(g.out_boundaries, g.out_offsets, g.out_indices);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto chunk = g.out_indices.data[thread_id];
+      const auto start = g.out_indices.range[thread_id];
+      const auto end = g.out_indices.range[thread_id + 1];
+      for (u64 i = start; i < end; ++i) {
+        chunk[i - start] = static_cast<ID>(indices[i]);
+      }
+    });
+    // indices of a row may come unsorted (e.g. scipy without sort_indices())
+    g.set_rest_from_out();
+
+    return g;
+  }
+
+  // casts each chunk of a per-edge column
+  template <class To, class From>
+  static colle::DiscreteArray<To>
+  convert(const colle::DiscreteArray<From> &from) {
+    const u32 num_chunks = from.data.size();
+    std::vector<To *> chunks(num_chunks);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      for (u32 n = thread_id; n < num_chunks; n += loop::num_threads) {
+        const auto length = from.range[n + 1] - from.range[n];
+        chunks[n] = mem::malloc<To>(length, mock::thread_to_numa(n));
+        for (u32 i = 0; i < length; ++i) {
+          chunks[n][i] = static_cast<To>(from.data[n][i]);
+        }
+      }
+    });
+    colle::DiscreteArray<To> to;
+    for (u32 n = 0; n < num_chunks; ++n) {
+      to.add(chunks[n], from.range[n + 1] - from.range[n]);
+      to.own(chunks[n], from.range[n + 1] - from.range[n]);
     }
+    return to;
+  }
 
-    auto g = _Graph();
+  // the same topology as another Graph type, e.g. to run a different kernel
+  // on a built graph. topology arrays are shared and kept alive by both,
+  // v_data and e_data are new
+  template <class VProp2, class EProp2, class VData2, class EData2>
+  Graph<ID, VProp2, EProp2, VData2, EData2, IsDirected> rebind() const {
+    auto g = Graph<ID, VProp2, EProp2, VData2, EData2, IsDirected>();
     g.num_vertices = num_vertices;
     g.num_edges = num_edges;
-    g.tmp_out_offsets = out_offsets;
-    g.tmp_out_indices = out_indices;
-    g.tmp_in_offsets = in_offsets;
-    g.tmp_in_indices = in_indices;
-    g.set_out_boundaries();
-    g.set_out_offsets();
-    g.set_out_degrees();
-    g.set_out_indices();
-    g.set_out_neighbor();
-    g.set_in_boundaries();
-    g.set_in_offsets();
-    g.set_in_degrees();
-    g.set_in_indices();
-    g.set_in_neighbor();
-    g.set_forward_indices();
+    g.out_offsets = out_offsets.share();
+    g.out_indices = out_indices.share();
+    g.out_boundaries = out_boundaries;
+    g.in_offsets = in_offsets.share();
+    g.in_indices = in_indices.share();
+    g.in_compressed = in_compressed.share();
+    g.in_skips = in_skips.share();
+    g.in_boundaries = in_boundaries;
+    g.owned_boundaries = owned_boundaries;
+    g.forward_indices = forward_indices.share();
+    g.external_ids = external_ids;
+    g.internal_ids = internal_ids;
+    g.reordering = reordering;
+    g.snapshot_file = snapshot_file;
+    g.out_offsets_is_initialized = out_offsets_is_initialized;
+    g.out_indices_is_initialized = out_indices_is_initialized;
+    g.in_offsets_is_initialized = in_offsets_is_initialized;
+    g.in_indices_is_initialized = in_indices_is_initialized;
+    g.out_boundaries_is_initialized = out_boundaries_is_initialized;
+    g.in_boundaries_is_initialized = in_boundaries_is_initialized;
+    g.forward_indices_is_initialized = forward_indices_is_initialized;
+    g.in_indices_is_compressed = in_indices_is_compressed;
+    g.direction = direction;
+    g.cleanup = cleanup;
+    if (!out_e_props.data.empty()) {
+      g.out_e_props = convert<typename decltype(g)::_EPropColumn>(out_e_props);
+    }
     g.set_v_data();
-    g.set_e_data();
-
-    assert(g.out_degrees_is_initialized);
-    assert(g.out_offsets_is_initialized);
-    assert(g.out_indices_is_initialized);
-    assert(g.in_degrees_is_initialized);
-    assert(g.in_offsets_is_initialized);
-    assert(g.in_indices_is_initialized);
-    assert(g.out_boundaries_is_initialized);
-    assert(g.in_boundaries_is_initialized);
-    assert(g.forward_indices_is_initialized);
-
+    if (direction == Direction::Both) {
+      g.set_e_data();
+    }
     return g;
   }
 
-  // TODO: Poor performance
-  // *require packed index* (process in pre-processing)
-  static _Graph
-  from_adjacency_list(const std::vector<std::vector<ID>> &adjacency_list) {
-    assert(!adjacency_list.empty());
-
-    const auto num_vertices = adjacency_list.size();
-
-    std::vector<std::set<ID>> inv_adjacency_list{num_vertices, std::set<ID>{}};
-    auto out_offsets = new std::vector<ID>{};
-    out_offsets->reserve(num_vertices + 1);
-    auto out_indices = new std::vector<ID>{};
-    u32 out_offset = 0;
-    for (u32 i = 0; i < num_vertices; ++i) {
-      const auto nghs = adjacency_list[i];
-      out_offsets->emplace_back(out_offset);
-      // out_indices->reserve(out_indices->size() + nghs.size()); //
-      std::copy(nghs.begin(), nghs.end(), std::back_inserter(*out_indices));
-      out_offset += nghs.size();
-
-      for (const auto &ngh : nghs) {
-        inv_adjacency_list[ngh].emplace(i);
+  /*
+   * `weights[i]` belongs to `edge_list[i]` and is kept as out_e_props.
+   * an undirected graph keeps it on both slots of the edge, slot
+   * `num_edges + i` in `order` below is the reverse of edge i
+   */
+  static _Graph from_edge_list(const std::vector<std::pair<ID, ID>> &edge_list,
+                               const std::vector<f32> &weights) {
+    assert(edge_list.size() == weights.size());
+
+    // out-edge order is (src, dst); ties keep the input order, on both
+    // slots of parallel edges alike
+    const auto num_edges = edge_list.size();
+    std::vector<u64> order;
+    order.reserve(IsDirected ? num_edges : 2 * num_edges);
+    for (u64 i = 0; i < num_edges; ++i) {
+      order.emplace_back(i);
+    }
+    for (u64 i = 0; !IsDirected && i < num_edges; ++i) {
+      if (edge_list[i].first != edge_list[i].second) {
+        order.emplace_back(num_edges + i);
       }
     }
-    out_offsets->emplace_back(out_offset);
+    const auto slot = [&](const u64 i) {
+      return i < num_edges ? edge_list[i]
+                           : std::make_pair(edge_list[i - num_edges].second,
+                                            edge_list[i - num_edges].first);
+    };
+    std::sort(begin(order), end(order), [&](const u64 l, const u64 r) {
+      return std::make_pair(slot(l), l % num_edges) <
+             std::make_pair(slot(r), r % num_edges);
+    });
+    // an integral column keeps whole weights in its range only, others
+    // would be truncated (or undefined if negative) by the cast
+    if (std::is_integral<_EPropColumn>::value) {
+      for (const auto weight : weights) {
+        if (weight != std::trunc(weight) ||
+            weight < std::numeric_limits<_EPropColumn>::lowest() ||
+            weight > std::numeric_limits<_EPropColumn>::max()) {
+          throw std::invalid_argument(
+              "weight not representable by the edge property: " +
+              std::to_string(weight));
+        }
+      }
+    }
+    const auto e_props = mem::malloc<_EPropColumn>(order.size());
+    for (u64 i = 0; i < order.size(); ++i) {
+      e_props[i] = static_cast<_EPropColumn>(weights[order[i] % num_edges]);
+    }
+    std::vector<u64>().swap(order);
 
-    const auto num_edges = out_offset;
+    auto g = from_edge_list(edge_list);
+    g.set_out_e_props(e_props);
+    return g;
+  }
 
-    auto in_offsets = new std::vector<ID>{};
-    in_offsets->reserve(num_vertices);
-    auto in_indices = new std::vector<ID>{};
-    // in_indices->reserve(num_edges);
-    u32 in_offset = 0;
-    for (const auto &nghs : inv_adjacency_list) {
-      in_offsets->emplace_back(in_offset);
-      // in_indices->reserve(in_indices->size() + nghs.size()); //
-      std::copy(nghs.begin(), nghs.end(), std::back_inserter(*in_indices));
-      in_offset += nghs.size();
-    }
-    in_offsets->emplace_back(in_offset);
+  /*
+   * [#vertices] -> out-neighbors. lists are copied once into the per-thread
+   * chunks and sorted there, in-edges are derived by set_in_from_out
+   * (symmetric lists are expected for an undirected graph)
+   * *require packed index* (process in pre-processing)
+   */
+  static _Graph
+  from_adjacency_list(const std::vector<std::vector<ID>> &adjacency_list,
+                      const Direction direction = Direction::Both) {
+    assert(!adjacency_list.empty());
 
+    const u64 num_vertices = adjacency_list.size();
     auto g = _Graph();
-    g.num_vertices = num_vertices;
-    g.num_edges = num_edges;
-    g.tmp_out_offsets = out_offsets->data();
-    g.tmp_out_indices = out_indices->data();
-    g.tmp_in_offsets = in_offsets->data();
-    g.tmp_in_indices = in_indices->data();
-    g.set_out_boundaries();
+    g.direction = direction;
+    g.num_vertices = static_cast<ID>(num_vertices);
+    g.tmp_out_offsets = mem::malloc<ID>(num_vertices + 1);
+    g.tmp_out_offsets[0] = 0;
+    for (u64 v = 0; v < num_vertices; ++v) {
+      g.tmp_out_offsets[v + 1] =
+          g.tmp_out_offsets[v] + static_cast<ID>(adjacency_list[v].size());
+    }
+    g.num_edges = g.tmp_out_offsets[num_vertices];
+
+    const auto in_offsets =
+        g.count_in_offsets([&](u32 thread_id, std::atomic<ID> *counts) {
+          const auto lower = num_vertices * thread_id / loop::num_threads;
+          const auto upper = num_vertices * (thread_id + 1) / loop::num_threads;
+          for (u64 v = lower; v < upper; ++v) {
+            for (const auto u : adjacency_list[v]) {
+              counts[u + 1].fetch_add(1, std::memory_order_relaxed);
+            }
+          }
+        });
+    g.set_boundaries(in_offsets);
+    g.free_offsets(in_offsets);
     g.set_out_offsets();
-    g.set_out_degrees();
-    g.set_out_indices();
-    g.set_out_neighbor();
-    g.set_in_boundaries();
-    g.set_in_offsets();
-    g.set_in_degrees();
-    g.set_in_indices();
-    g.set_in_neighbor();
-    g.set_forward_indices();
-    g.set_v_data();
-    g.set_e_data();
-
-    assert(g.out_degrees_is_initialized);
-    assert(g.out_offsets_is_initialized);
-    assert(g.out_indices_is_initialized);
-    assert(g.in_degrees_is_initialized);
-    assert(g.in_offsets_is_initialized);
-    assert(g.in_indices_is_initialized);
-    assert(g.out_boundaries_is_initialized);
-    assert(g.in_boundaries_is_initialized);
-    assert(g.forward_indices_is_initialized);
+    alloc_indices(g.out_boundaries, g.out_offsets, g.out_indices);
+    loop::parallel_each_thread(g.out_boundaries, [&](u32 thread_id,
+                                                     u32 numa_id, ID lower,
+                                                     ID upper) {
+      const auto chunk =
+          g.out_indices.data[thread_id] - g.out_indices.range[thread_id];
+      for (ID v = lower; v < upper; ++v) {
+        const auto &nghs = adjacency_list[v];
+        std::copy(nghs.begin(), nghs.end(),
+                  chunk + g.out_offsets(v, thread_id, 0));
+      }
+    });
+    g.set_rest_from_out();
 
     return g;
   }
@@ -0,0 +1,118 @@
+#ifndef HOSHIZORA_GZIP_READER_H
+#define HOSHIZORA_GZIP_READER_H
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "hoshizora/core/includes.h"
+#include "hoshizora/core/mapped_file.h"
+
+namespace hoshizora {
+/*
+ * Inflates an mmapped gzip file (including concatenated members) into
+ * blocks of whole lines, so that each block can be parsed on its own.
+ */
+struct GzipReader {
+  const std::string file_name;
+  MappedFile file;
+  z_stream stream{};
+  bool finished = false;
+  std::vector<char> carry; // incomplete last line of the previous block
+
+  explicit GzipReader(const std::string &file_name)
+      : file_name(file_name), file(file_name) {
+    madvise(file.data, file.size, MADV_SEQUENTIAL);
+    // 16: gzip wrapper only
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+      throw std::runtime_error("Cannot inflate " + file_name);
+    }
+    stream.next_in = reinterpret_cast<Bytef *>(file.data);
+    stream.avail_in = 0;
+    finished = file.size == 0;
+  }
+
+  GzipReader(const GzipReader &) = delete;
+
+  GzipReader &operator=(const GzipReader &) = delete;
+
+  ~GzipReader() { inflateEnd(&stream); }
+
+  static bool is_gzip(const std::string &file_name) {
+    std::ifstream ifs(file_name, std::ios::in | std::ios::binary);
+    unsigned char magic[2] = {};
+    ifs.read(reinterpret_cast<char *>(magic), sizeof(magic));
+    return ifs.gcount() == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+  }
+
+  // replaces `text` with at least `size` bytes (unless the file ends) of
+  // whole lines; false if nothing is left
+  bool next(std::vector<char> &text, const u64 size) {
+    text.swap(carry);
+    carry.clear();
+    if (finished && text.empty()) {
+      return false;
+    }
+
+    auto searched = text.size();
+    while (!finished) {
+      const auto head = text.size();
+      text.resize(std::max(head + size / 2, size));
+      inflate_into(text.data() + head, text.size() - head, text);
+      if (finished || text.size() >= size) {
+        // cut after the last newline, at least one line per block
+        const auto nl = memrchr(text.data() + searched, '\n',
+                                text.size() - searched);
+        if (nl != nullptr) {
+          const auto length =
+              static_cast<u64>(static_cast<const char *>(nl) - text.data()) +
+              1;
+          carry.assign(text.begin() + length, text.end());
+          text.resize(length);
+          return true;
+        }
+        searched = text.size();
+      }
+    }
+    return !text.empty();
+  }
+
+private:
+  // inflates into [out, out + size) and shrinks `text` to the end of output
+  void inflate_into(char *const out, const u64 size, std::vector<char> &text) {
+    stream.next_out = reinterpret_cast<Bytef *>(out);
+    stream.avail_out = static_cast<uInt>(size);
+    while (stream.avail_out > 0 && !finished) {
+      if (stream.avail_in == 0) {
+        // zlib counts input in uInt, so feed the mapping in slices
+        const auto consumed =
+            static_cast<u64>(reinterpret_cast<char *>(stream.next_in) -
+                             file.data);
+        stream.avail_in =
+            static_cast<uInt>(std::min(file.size - consumed, 1ul << 30u));
+      }
+      const auto ret = inflate(&stream, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END) {
+        const auto consumed =
+            static_cast<u64>(reinterpret_cast<char *>(stream.next_in) -
+                             file.data);
+        if (consumed == file.size) {
+          finished = true;
+        } else {
+          inflateReset(&stream); // next member
+        }
+      } else if (ret != Z_OK) {
+        throw std::runtime_error("Broken gzip " + file_name);
+      }
+    }
+    text.resize(static_cast<u64>(reinterpret_cast<char *>(stream.next_out) -
+                                 text.data()));
+  }
+};
+} // namespace hoshizora
+
+#endif // HOSHIZORA_GZIP_READER_H
@@ -0,0 +1,182 @@
+#ifndef HOSHIZORA_ID_MAP_H
+#define HOSHIZORA_ID_MAP_H
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hoshizora/core/includes.h"
+#include "hoshizora/core/loop.h"
+
+namespace hoshizora {
+/*
+ * Maps arbitrary u64 external IDs to dense internal IDs in [0, #vertices).
+ *
+ * Keys are inserted concurrently into an open-addressing table (linear
+ * probing, CAS on empty slots). `compact` then numbers the distinct keys in
+ * ascending order, so already packed inputs keep their IDs, and keeps the
+ * reverse mapping in `external_ids`.
+ *
+ * EMPTY marks empty slots, so that key itself is kept outside the table.
+ */
+template <class ID> struct IdMap {
+  static constexpr u64 EMPTY = ~0ul;
+
+  u64 capacity;
+  u64 mask;
+  std::unique_ptr<std::atomic<u64>[]> keys;
+  std::unique_ptr<ID[]> values;
+  std::atomic<bool> has_empty_key{false};
+  ID empty_key_value = 0;
+  std::vector<u64> external_ids; // [internal id] -> external id
+
+  // `max_num_keys` bounds #distinct keys, e.g. 2 * #edges
+  explicit IdMap(const u64 max_num_keys)
+      : capacity(next_pow2(std::max(max_num_keys + max_num_keys / 2, 2ul))),
+        mask(capacity - 1), keys(new std::atomic<u64>[capacity]),
+        values(new ID[capacity]) {
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto lower = capacity * thread_id / loop::num_threads;
+      const auto upper = capacity * (thread_id + 1) / loop::num_threads;
+      for (u64 slot = lower; slot < upper; ++slot) {
+        keys[slot].store(EMPTY, std::memory_order_relaxed);
+      }
+    });
+  }
+
+  static inline u64 next_pow2(u64 x) {
+    u64 p = 1;
+    while (p < x) {
+      p <<= 1u;
+    }
+    return p;
+  }
+
+  // fmix64 of MurmurHash3
+  static inline u64 hash(u64 key) {
+    key ^= key >> 33u;
+    key *= 0xff51afd7ed558ccdul;
+    key ^= key >> 33u;
+    key *= 0xc4ceb9fe1a85ec53ul;
+    key ^= key >> 33u;
+    return key;
+  }
+
+  // thread-safe
+  inline void insert(const u64 key) {
+    if (key == EMPTY) {
+      has_empty_key.store(true, std::memory_order_relaxed);
+      return;
+    }
+    for (auto slot = hash(key) & mask;; slot = (slot + 1) & mask) {
+      auto curr = keys[slot].load(std::memory_order_relaxed);
+      if (curr == key) {
+        return;
+      }
+      if (curr == EMPTY) {
+        if (keys[slot].compare_exchange_strong(curr, key,
+                                               std::memory_order_relaxed)) {
+          return;
+        }
+        if (curr == key) {
+          return;
+        }
+      }
+    }
+  }
+
+  inline u64 slot_of(const u64 key) const {
+    auto slot = hash(key) & mask;
+    while (keys[slot].load(std::memory_order_relaxed) != key) {
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  // requires `key` to be inserted and `compact` to be done
+  inline ID find(const u64 key) const {
+    return key == EMPTY ? empty_key_value : values[slot_of(key)];
+  }
+
+  void compact() {
+    std::vector<std::vector<u64>> partial_keys(loop::num_threads);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto lower = capacity * thread_id / loop::num_threads;
+      const auto upper = capacity * (thread_id + 1) / loop::num_threads;
+      for (u64 slot = lower; slot < upper; ++slot) {
+        const auto key = keys[slot].load(std::memory_order_relaxed);
+        if (key != EMPTY) {
+          partial_keys[thread_id].emplace_back(key);
+        }
+      }
+    });
+
+    external_ids.clear();
+    for (auto &partial : partial_keys) {
+      external_ids.insert(external_ids.end(), partial.begin(), partial.end());
+      std::vector<u64>().swap(partial);
+    }
+    std::sort(external_ids.begin(), external_ids.end()); // parallel mode
+    // the largest key, numbered last
+    if (has_empty_key.load(std::memory_order_relaxed)) {
+      external_ids.emplace_back(EMPTY);
+    }
+
+    const auto num_ids = external_ids.size();
+    if (num_ids > std::numeric_limits<ID>::max()) {
+      throw std::invalid_argument("too many distinct IDs for the ID type: " +
+                                  std::to_string(num_ids));
+    }
+    const auto num_table_ids =
+        has_empty_key.load(std::memory_order_relaxed) ? num_ids - 1 : num_ids;
+    empty_key_value = static_cast<ID>(num_table_ids);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto lower = num_table_ids * thread_id / loop::num_threads;
+      const auto upper = num_table_ids * (thread_id + 1) / loop::num_threads;
+      for (u64 id = lower; id < upper; ++id) {
+        values[slot_of(external_ids[id])] = static_cast<ID>(id);
+      }
+    });
+  }
+
+  // builds the map from both ends of edges and rewrites them to internal IDs
+  static std::vector<std::pair<ID, ID>>
+  remap(const std::vector<std::pair<u64, u64>> &edge_list,
+        std::vector<u64> &external_ids) {
+    const auto num_edges = edge_list.size();
+    IdMap ids(num_edges * 2);
+
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto lower = num_edges * thread_id / loop::num_threads;
+      const auto upper = num_edges * (thread_id + 1) / loop::num_threads;
+      for (u64 i = lower; i < upper; ++i) {
+        ids.insert(edge_list[i].first);
+        ids.insert(edge_list[i].second);
+      }
+    });
+    ids.compact();
+
+    std::vector<std::pair<ID, ID>> remapped(num_edges);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto lower = num_edges * thread_id / loop::num_threads;
+      const auto upper = num_edges * (thread_id + 1) / loop::num_threads;
+      for (u64 i = lower; i < upper; ++i) {
+        remapped[i] = std::make_pair(ids.find(edge_list[i].first),
+                                     ids.find(edge_list[i].second));
+      }
+    });
+
+    debug::logger->info("remapped {} external ids", ids.external_ids.size());
+    external_ids = std::move(ids.external_ids);
+    return remapped;
+  }
+};
+
+template <class ID> constexpr u64 IdMap<ID>::EMPTY;
+} // namespace hoshizora
+
+#endif // HOSHIZORA_ID_MAP_H
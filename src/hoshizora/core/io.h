@@ -1,18 +1,89 @@
 #ifndef HOSHIZORA_IO_H
 #define HOSHIZORA_IO_H
 
+#include "hoshizora/core/bounded_queue.h"
+#include "hoshizora/core/external_builder.h"
 #include "hoshizora/core/graph.h"
+#include "hoshizora/core/gzip_reader.h"
+#include "hoshizora/core/id_map.h"
 #include "hoshizora/core/includes.h"
+#include "hoshizora/core/loop.h"
+#include "hoshizora/core/mapped_file.h"
+#include "hoshizora/core/reorder.h"
+#include "hoshizora/core/tokenizer.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <fstream>
 #include <ios>
 #include <iostream>
 #include <iterator>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 
 #include <cstdlib>
 #include <unistd.h>
 
 namespace hoshizora {
+enum class Format {
+  Auto,         // Matrix Market by the banner, Weighted by a float weight
+  Snap,         // `src dst` with `#` comments
+  MatrixMarket, // coordinate, 1-based, `%` comments
+  Weighted,     // `src dst weight`
+};
+
+static inline const char *to_string(const Format format) {
+  switch (format) {
+  case Format::Snap:
+    return "snap";
+  case Format::MatrixMarket:
+    return "mtx";
+  case Format::Weighted:
+    return "weighted";
+  default:
+    return "auto";
+  }
+}
+
+static inline Format parse_format(const std::string &name) {
+  for (const auto format : {Format::Auto, Format::Snap, Format::MatrixMarket,
+                            Format::Weighted}) {
+    if (name == to_string(format)) {
+      return format;
+    }
+  }
+  throw std::invalid_argument("Unknown format: " + name);
+}
+
+struct LoadOptions {
+  Format format = Format::Auto;
+  // binary snapshot of the built graph; written on the first load and
+  // reused while the source file keeps its size and mtime
+  std::string snapshot_file;
+  // upper bound of the working memory in bytes for building a graph larger
+  // than RAM through sorted runs spilled to `spill_dir`; 0 builds in memory
+  u64 memory_budget = 0;
+  std::string spill_dir = "/tmp";
+  // compacts arbitrary u64 IDs into dense ones; the original IDs are kept
+  // in Graph::external_ids
+  bool remap_ids = false;
+  // CSRs to build, narrowed by apps to what their kernel walks. a snapshot
+  // is always written from a full graph
+  Direction direction = Direction::Both;
+  // removes parallel edges and/or self-loops while building
+  Cleanup cleanup;
+  // relabels vertices for locality; the original IDs are kept in
+  // Graph::external_ids as with remap_ids
+  Reordering reordering = Reordering::None;
+  // packs in-lists by compress/ for kernels walking in-edges only
+  // (PageRank), a snapshot keeps them as they are
+  bool compress = false;
+};
+
 struct IO {
 
   static inline bool isSpace(char c) {
@@ -28,48 +99,666 @@ struct IO {
     }
   }
 
-  //        template<class Graph>
-  static std::vector<std::pair<u32, u32>>
-  from_file(const std::string &file_name) {
-    std::ifstream ifs(file_name, std::ios::in);
-    std::istreambuf_iterator<char> it(ifs);
-    std::istreambuf_iterator<char> last;
-    std::string data(it, last);
+  static inline bool isDigit(char c) {
+    return static_cast<u8>(c - '0') < 10u;
+  }
+
+  // moves `pos` forward to the head of the line containing it (or the next
+  // one), so that each chunk owns whole lines only
+  static inline u64 next_line(const char *const data, const u64 size,
+                              const u64 pos) {
+    if (pos == 0 || pos >= size) {
+      return std::min(pos, size);
+    }
+    const auto nl = static_cast<const char *>(
+        std::memchr(data + pos - 1, '\n', size - pos + 1));
+    return nl == nullptr ? size : static_cast<u64>(nl - data) + 1;
+  }
+
+  // `#`/`%` comments, `src dst [weight]` lines and the Matrix Market
+  // header of a text edge list
+  struct Syntax {
+    Format format = Format::Snap;
+    u64 data_offset = 0; // head of the first edge line
+    bool one_based = false;
+    bool symmetric = false;      // each off-diagonal entry is both ways
+    bool skew_symmetric = false; // ... with the weight negated
+    bool has_weights = false;
 
-    auto start = 0ul;
-    auto first = 0ul, second = 0ul;
+    // a line of k bytes holds at most 1 edge (k >= 4), or 2 if symmetric
+    u64 min_bytes_per_edge() const { return symmetric ? 2 : 4; }
+  };
+
+  static std::string to_lower(std::string str) {
+    std::transform(str.begin(), str.end(), str.begin(),
+                   [](const char c) { return std::tolower(c); });
+    return str;
+  }
+
+  // e.g. `0.5`, `1e-3`, but not `1`
+  static bool is_float(const std::string &str) {
+    char *end = nullptr;
+    std::strtod(str.c_str(), &end);
+    return !str.empty() && end == str.c_str() + str.size() &&
+           str.find_first_not_of("0123456789+-.eE") == std::string::npos &&
+           str.find_first_of(".eE") != std::string::npos;
+  }
 
-    std::vector<std::pair<u32, u32>> edge_list;
-    edge_list.reserve(5105039); // TODO
+  // reads the header (Matrix Market) or the first edge line (others) from
+  // the head of the input and resolves Format::Auto
+  static Syntax sniff(const char *const head, const char *const tail,
+                      const Format format) {
+    static const char banner[] = "%%MatrixMarket";
+    const auto banner_length = sizeof(banner) - 1;
+    const bool has_banner =
+        static_cast<u64>(tail - head) >= banner_length &&
+        std::memcmp(head, banner, banner_length) == 0;
 
-    for (auto &datum : data) {
-      if (isSpace(datum)) {
-        datum = '\0';
+    // first line starting with a digit at or after `p`
+    const auto first_data_line = [tail](const char *p) {
+      for (; p < tail; p = tokenizer::next_line(p, tail)) {
+        auto q = p;
+        while (q < tail && tokenizer::is_blank(*q)) {
+          ++q;
+        }
+        if (q < tail && tokenizer::is_digit(*q)) {
+          break;
+        }
+      }
+      return p;
+    };
+
+    Syntax syntax;
+    if (format == Format::MatrixMarket ||
+        (format == Format::Auto && has_banner)) {
+      if (!has_banner) {
+        throw std::runtime_error("Missing Matrix Market banner");
+      }
+      std::istringstream line(
+          std::string(head, tokenizer::next_line(head, tail)));
+      std::string tag, object, layout, field, symmetry;
+      line >> tag >> object >> layout >> field >> symmetry;
+      if (to_lower(object) != "matrix" || to_lower(layout) != "coordinate") {
+        throw std::runtime_error("Unsupported Matrix Market type: " + object +
+                                 " " + layout);
       }
+      // complex weights and hermitian matrices have no f32 weight per edge
+      field = to_lower(field);
+      symmetry = to_lower(symmetry);
+      if (field != "real" && field != "integer" && field != "pattern") {
+        throw std::runtime_error("Unsupported Matrix Market field: " + field);
+      }
+      if (symmetry != "general" && symmetry != "symmetric" &&
+          symmetry != "skew-symmetric") {
+        throw std::runtime_error("Unsupported Matrix Market symmetry: " +
+                                 (symmetry.empty() ? "(none)" : symmetry));
+      }
+      syntax.format = Format::MatrixMarket;
+      syntax.one_based = true;
+      syntax.has_weights = field != "pattern";
+      syntax.skew_symmetric = symmetry == "skew-symmetric";
+      syntax.symmetric = symmetry == "symmetric" || syntax.skew_symmetric;
+      // the first line with digits is `#rows #cols #entries`
+      const auto size_line = first_data_line(head);
+      syntax.data_offset = static_cast<u64>(
+          tokenizer::next_line(size_line, tail) - head);
+      return syntax;
     }
 
-    bool is_first = true;
-    for (u32 i = 0, end = data.length(); i < end; ++i) {
-      if ((data[i] == '\0') || i == end - 1) {
-        if (i > 0 && data[i - 1] == '\0') {
-          start++;
+    syntax.format = format;
+    if (format == Format::Auto) {
+      // `src dst weight` only if there are exactly 3 columns and the third
+      // is a float with a fraction or an exponent, an integral third column
+      // (e.g. a timestamp) is not taken as a weight
+      std::vector<std::string> columns;
+      auto p = first_data_line(head);
+      while (p < tail && *p != '\n') {
+        if (tokenizer::is_blank(*p)) {
+          ++p;
           continue;
         }
+        const auto q = p;
+        while (p < tail && *p != '\n' && !tokenizer::is_blank(*p)) {
+          ++p;
+        }
+        columns.emplace_back(q, p);
+      }
+      syntax.format = columns.size() == 3 && is_float(columns[2])
+                          ? Format::Weighted
+                          : Format::Snap;
+    }
+    syntax.has_weights = syntax.format == Format::Weighted;
+    return syntax;
+  }
+
+  // sniff of the head of a file as the parsers see it, gzipped or not
+  static Syntax sniff_file(const std::string &file_name, const Format format) {
+    if (GzipReader::is_gzip(file_name)) {
+      GzipReader reader(file_name);
+      std::vector<char> text;
+      reader.next(text, 4ul << 20u); // as the first block of from_gzip_file
+      return sniff(text.data(), text.data() + text.size(), format);
+    }
+    const MappedFile file(file_name);
+    return sniff(file.data, file.data + file.size, format);
+  }
+
+  // a symmetric input read as an undirected graph, which holds both
+  // directions of an entry by itself (skew-symmetric weights do differ)
+  static bool is_undirected(const Syntax &syntax) {
+    return syntax.symmetric && !syntax.skew_symmetric;
+  }
+
+  // the syntax parse_edges follows for a graph: entries are mirrored into
+  // edge pairs for a directed graph only
+  static Syntax for_graph(Syntax syntax, const bool is_directed) {
+    if (!is_directed && syntax.skew_symmetric) {
+      throw std::invalid_argument(
+          "skew-symmetric input cannot be read as an undirected graph");
+    }
+    syntax.symmetric = syntax.symmetric && is_directed;
+    return syntax;
+  }
+
+  // parses edge lines in [head, tail); lines not starting with a digit
+  // (e.g. `#` or `%` comments) and lines with a single column are skipped.
+  // weights are parsed only if `weights` is given, 1 if a line has none
+  template <class ID>
+  static void parse_edges(const char *head, const char *const tail,
+                          const Syntax &syntax,
+                          std::vector<std::pair<ID, ID>> &edge_list,
+                          std::vector<f32> *weights = nullptr) {
+    const auto skip_blanks = [tail](const char *p) {
+      while (p < tail && tokenizer::is_blank(*p)) {
+        ++p;
+      }
+      return p;
+    };
+    const ID base = syntax.one_based ? 1 : 0;
+
+    while (head < tail) {
+      const auto line = head;
+      head = skip_blanks(head);
+      if (head < tail && tokenizer::is_digit(*head)) {
+        ID src, dst;
+        head = skip_blanks(tokenizer::parse_uint(head, tail, src, line));
+        if (head < tail && tokenizer::is_digit(*head)) {
+          head = skip_blanks(tokenizer::parse_uint(head, tail, dst, line));
+          src -= base;
+          dst -= base;
+          edge_list.emplace_back(src, dst);
+          const bool mirrored = syntax.symmetric && src != dst;
+          if (mirrored) {
+            edge_list.emplace_back(dst, src);
+          }
+
+          if (weights != nullptr) {
+            f32 weight = 1;
+            if (head < tail && (tokenizer::is_digit(*head) || *head == '-' ||
+                                *head == '.')) {
+              head = tokenizer::parse_float(head, tail, weight);
+            }
+            weights->emplace_back(weight);
+            if (mirrored) {
+              weights->emplace_back(syntax.skew_symmetric ? -weight : weight);
+            }
+          }
+        }
+      }
+      head = tokenizer::next_line(head, tail);
+    }
+  }
+
+  // mmaps the file, splits it into one chunk per thread at line boundaries
+  // and parses the chunks in parallel. weights are collected into `weights`
+  // if it is given and the format has them. symmetric entries are kept once
+  // for an undirected graph
+  template <class ID = u32>
+  static std::vector<std::pair<ID, ID>>
+  from_file(const std::string &file_name, const Format format = Format::Auto,
+            std::vector<f32> *weights = nullptr,
+            const bool is_directed = true) {
+    if (GzipReader::is_gzip(file_name)) {
+      return from_gzip_file<ID>(file_name, format, weights, is_directed);
+    }
+
+    const MappedFile file(file_name);
+    const auto num_threads = loop::num_threads;
+    const auto syntax =
+        for_graph(sniff(file.data, file.data + file.size, format), is_directed);
+    if (!syntax.has_weights) {
+      weights = nullptr;
+    }
+
+    const auto data_size = file.size - syntax.data_offset;
+    std::vector<u64> boundaries(num_threads + 1);
+    for (u32 thread_id = 0; thread_id <= num_threads; ++thread_id) {
+      boundaries[thread_id] =
+          thread_id == 0
+              ? syntax.data_offset
+              : next_line(file.data, file.size,
+                          syntax.data_offset +
+                              data_size * thread_id / num_threads);
+    }
+
+    // the reservation by the shortest possible line (e.g. `0 0\n`) never
+    // regrows; untouched pages of it are not backed by physical memory
+    std::vector<std::vector<std::pair<ID, ID>>> partial_edge_lists(
+        num_threads);
+    std::vector<std::vector<f32>> partial_weights(num_threads);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto lower = boundaries[thread_id];
+      const auto upper = boundaries[thread_id + 1];
+      const auto capacity = (upper - lower) / syntax.min_bytes_per_edge() + 1;
+      auto &partial = partial_edge_lists[thread_id];
+      partial.reserve(capacity);
+      if (weights != nullptr) {
+        partial_weights[thread_id].reserve(capacity);
+      }
+      parse_edges(file.data + lower, file.data + upper, syntax, partial,
+                  weights == nullptr ? nullptr : &partial_weights[thread_id]);
+    });
+
+    std::vector<u64> offsets(num_threads + 1, 0);
+    for (u32 thread_id = 0; thread_id < num_threads; ++thread_id) {
+      offsets[thread_id + 1] =
+          offsets[thread_id] + partial_edge_lists[thread_id].size();
+    }
+
+    std::vector<std::pair<ID, ID>> edge_list(offsets[num_threads]);
+    if (weights != nullptr) {
+      weights->resize(offsets[num_threads]);
+    }
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      auto &partial = partial_edge_lists[thread_id];
+      std::copy(partial.begin(), partial.end(),
+                edge_list.begin() + offsets[thread_id]);
+      std::vector<std::pair<ID, ID>>().swap(partial);
+      if (weights != nullptr) {
+        auto &partial_weight = partial_weights[thread_id];
+        std::copy(partial_weight.begin(), partial_weight.end(),
+                  weights->begin() + offsets[thread_id]);
+        std::vector<f32>().swap(partial_weight);
+      }
+    });
+
+    debug::logger->info("parsed {} edges ({})", edge_list.size(),
+                        to_string(syntax.format));
+    return edge_list;
+  }
+
+  // inflates a gzipped file in this thread while the other threads parse
+  // the inflated blocks as they arrive, so nothing is written to disk.
+  // edges keep the order of the file
+  template <class ID = u32>
+  static std::vector<std::pair<ID, ID>>
+  from_gzip_file(const std::string &file_name,
+                 const Format format = Format::Auto,
+                 std::vector<f32> *weights = nullptr,
+                 const bool is_directed = true) {
+    static constexpr u64 block_size = 4ul << 20u;
+
+    struct Block {
+      std::vector<char> text;
+      u64 head = 0; // skips the header in the first block
+      std::vector<std::pair<ID, ID>> edge_list;
+      std::vector<f32> weights;
+    };
+
+    GzipReader reader(file_name);
+    // deque keeps blocks in place while the producer appends
+    std::deque<Block> blocks;
+    blocks.emplace_back();
+    if (!reader.next(blocks.back().text, block_size)) {
+      return std::vector<std::pair<ID, ID>>();
+    }
+    const auto &first = blocks.back().text;
+    const auto syntax = for_graph(
+        sniff(first.data(), first.data() + first.size(), format), is_directed);
+    blocks.back().head = syntax.data_offset;
+    if (!syntax.has_weights) {
+      weights = nullptr;
+    }
+
+    BoundedQueue<Block *> queue(2ul * loop::num_threads);
+    std::exception_ptr error;
+    std::thread producer([&]() {
+      try {
+        queue.push(&blocks.back());
+        std::vector<char> text;
+        while (reader.next(text, block_size)) {
+          blocks.emplace_back();
+          blocks.back().text.swap(text);
+          queue.push(&blocks.back());
+        }
+      } catch (...) {
+        error = std::current_exception();
+      }
+      queue.close();
+    });
 
-        if (is_first) {
-          first = static_cast<u32>(std::atoi(data.data() + start));
-        } else {
-          second = static_cast<u32>(std::atoi(data.data() + start));
-          edge_list.emplace_back(std::make_pair(first, second));
+    // a parse error stops parsing but not draining, so that the producer
+    // is never left blocked on a full queue
+    std::vector<std::exception_ptr> parse_errors(loop::num_threads);
+    std::atomic<bool> failed(false);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      Block *block;
+      while (queue.pop(block)) {
+        if (!failed.load(std::memory_order_relaxed)) {
+          try {
+            parse_edges(block->text.data() + block->head,
+                        block->text.data() + block->text.size(), syntax,
+                        block->edge_list,
+                        weights == nullptr ? nullptr : &block->weights);
+          } catch (...) {
+            parse_errors[thread_id] = std::current_exception();
+            failed.store(true, std::memory_order_relaxed);
+          }
         }
-        is_first = !is_first;
-        start = i + 1;
+        std::vector<char>().swap(block->text);
+      }
+    });
+    producer.join();
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    for (const auto &parse_error : parse_errors) {
+      if (parse_error) {
+        std::rethrow_exception(parse_error);
       }
     }
 
+    std::vector<u64> offsets(blocks.size() + 1, 0);
+    for (u64 i = 0; i < blocks.size(); ++i) {
+      offsets[i + 1] = offsets[i] + blocks[i].edge_list.size();
+    }
+    std::vector<std::pair<ID, ID>> edge_list(offsets.back());
+    if (weights != nullptr) {
+      weights->resize(offsets.back());
+    }
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      for (u64 i = thread_id; i < blocks.size(); i += loop::num_threads) {
+        auto &block = blocks[i];
+        std::copy(block.edge_list.begin(), block.edge_list.end(),
+                  edge_list.begin() + offsets[i]);
+        std::vector<std::pair<ID, ID>>().swap(block.edge_list);
+        if (weights != nullptr) {
+          std::copy(block.weights.begin(), block.weights.end(),
+                    weights->begin() + offsets[i]);
+          std::vector<f32>().swap(block.weights);
+        }
+      }
+    });
+
+    debug::logger->info("parsed {} edges ({}, gzip)", edge_list.size(),
+                        to_string(syntax.format));
     return edge_list;
   }
 
+  // streams the file through bounded runs instead of materializing the
+  // whole edge list
+  template <class Graph>
+  static Graph from_file_external(const std::string &file_name,
+                                  const LoadOptions &options) {
+    using ID = typename Graph::_ID;
+
+    if (GzipReader::is_gzip(file_name)) {
+      return from_gzip_file_external<Graph>(file_name, options);
+    }
+
+    const MappedFile file(file_name);
+    madvise(file.data, file.size, MADV_SEQUENTIAL);
+    const auto page_size = static_cast<u64>(sysconf(_SC_PAGESIZE));
+    const auto syntax =
+        for_graph(sniff(file.data, file.data + file.size, options.format),
+                  Graph::is_directed);
+    check_external<Graph>(syntax);
+    const auto bytes_per_edge = syntax.min_bytes_per_edge();
+
+    ExternalBuilder<Graph> builder(options.memory_budget, options.spill_dir);
+    const auto capacity = builder.run_capacity();
+    std::vector<std::pair<ID, ID>> run;
+    run.reserve(capacity);
+
+    u64 lower = syntax.data_offset;
+    while (lower < file.size) {
+      // a line holds at most an edge per `bytes_per_edge` and next_line
+      // extends the window by at most one line, so the run never regrows
+      const auto room = capacity - run.size();
+      if (room * bytes_per_edge < page_size + 4) {
+        builder.add_run(run);
+        run.clear();
+        continue;
+      }
+      const auto window = (room - 2) * bytes_per_edge;
+
+      const auto upper =
+          next_line(file.data, file.size, std::min(lower + window, file.size));
+      parse_edges(file.data + lower, file.data + upper, syntax, run);
+
+      // drop parsed pages so that the mapping does not stay resident
+      const auto release = upper / page_size * page_size;
+      const auto from = lower / page_size * page_size;
+      if (from < release) {
+        madvise(file.data + from, release - from, MADV_DONTNEED);
+      }
+      lower = upper;
+    }
+    builder.add_run(run);
+
+    return builder.build(options.direction, options.cleanup);
+  }
+
+  template <class Graph> static void check_external(const Syntax &syntax) {
+    if (syntax.has_weights && Graph::has_e_prop_column) {
+      throw std::invalid_argument(
+          "weighted edges cannot be combined with memory_budget");
+    }
+  }
+
+  // inflates and parses block by block into bounded runs; blocks are not
+  // pipelined here since the budget leaves no room for blocks in flight
+  template <class Graph>
+  static Graph from_gzip_file_external(const std::string &file_name,
+                                       const LoadOptions &options) {
+    using ID = typename Graph::_ID;
+
+    ExternalBuilder<Graph> builder(options.memory_budget, options.spill_dir);
+    const auto capacity = builder.run_capacity();
+    std::vector<std::pair<ID, ID>> run;
+    run.reserve(capacity);
+
+    GzipReader reader(file_name);
+    const auto block_size = std::min(4ul << 20u, capacity);
+    std::vector<char> text;
+    std::vector<std::pair<ID, ID>> edge_list;
+    Syntax syntax;
+    u64 head = 0;
+    for (bool first = true; reader.next(text, block_size); first = false) {
+      if (first) {
+        syntax = for_graph(
+            sniff(text.data(), text.data() + text.size(), options.format),
+            Graph::is_directed);
+        check_external<Graph>(syntax);
+        head = syntax.data_offset;
+      }
+      parse_edges(text.data() + head, text.data() + text.size(), syntax,
+                  edge_list);
+      head = 0;
+
+      for (const auto &edge : edge_list) {
+        run.emplace_back(edge);
+        if (run.size() == capacity) {
+          builder.add_run(run);
+          run.clear();
+        }
+      }
+      edge_list.clear();
+    }
+    builder.add_run(run);
+
+    return builder.build(options.direction, options.cleanup);
+  }
+
+  template <class Graph>
+  static Graph build(const std::string &file_name,
+                     const LoadOptions &options) {
+    using ID = typename Graph::_ID;
+
+    // only a Graph with an arithmetic EProp keeps weights
+    std::vector<f32> weight_column;
+    const auto weights = Graph::has_e_prop_column ? &weight_column : nullptr;
+
+    std::vector<u64> external_ids;
+    std::vector<std::pair<ID, ID>> edge_list;
+    if (options.remap_ids) {
+      if (options.memory_budget > 0) {
+        throw std::invalid_argument(
+            "remap_ids cannot be combined with memory_budget");
+      }
+      edge_list = IdMap<ID>::remap(
+          from_file<u64>(file_name, options.format, weights,
+                         Graph::is_directed),
+          external_ids);
+    } else if (options.memory_budget > 0) {
+      if (options.reordering != Reordering::None) {
+        throw std::invalid_argument(
+            "reordering cannot be combined with memory_budget");
+      }
+      // parsing and construction are fused here
+      auto graph = from_file_external<Graph>(file_name, options);
+      debug::point("loaded");
+      return graph;
+    } else {
+      edge_list = from_file<ID>(file_name, options.format, weights,
+                                Graph::is_directed);
+    }
+    debug::point("loaded");
+
+    std::vector<ID> new_ids;
+    if (options.reordering != Reordering::None) {
+      new_ids = reorder(edge_list, options.reordering, external_ids);
+    }
+    auto graph = from_edge_list<Graph>(edge_list, weights, options);
+    graph.external_ids = std::move(external_ids);
+    // ranks of original IDs are the IDs before reordering
+    graph.internal_ids = std::move(new_ids);
+    graph.reordering = options.reordering;
+    return graph;
+  }
+
+  /*
+   * relabels `edge_list` in place and returns [old ID] -> new ID. the new
+   * order is composed into `external_ids`, which become [new ID] -> original
+   * ID (identity for old IDs unless remapped)
+   */
+  template <class ID>
+  static std::vector<ID> reorder(std::vector<std::pair<ID, ID>> &edge_list,
+                                 const Reordering reordering,
+                                 std::vector<u64> &external_ids) {
+    const auto num_edges = edge_list.size();
+    u64 num_vertices = external_ids.size();
+    if (num_vertices == 0) {
+      std::vector<u64> max_ids(loop::num_threads, 0);
+      loop::fork_join([&](u32 thread_id, u32 numa_id) {
+        const auto lower = num_edges * thread_id / loop::num_threads;
+        const auto upper = num_edges * (thread_id + 1) / loop::num_threads;
+        for (u64 i = lower; i < upper; ++i) {
+          max_ids[thread_id] =
+              std::max<u64>(max_ids[thread_id],
+                            std::max(edge_list[i].first, edge_list[i].second));
+        }
+      });
+      num_vertices = *std::max_element(max_ids.begin(), max_ids.end()) + 1;
+    }
+
+    auto new_ids =
+        Reorder<ID>::permutation(edge_list, num_vertices, reordering);
+    Reorder<ID>::relabel(edge_list, new_ids);
+
+    std::vector<u64> reordered(num_vertices);
+    loop::fork_join([&](u32 thread_id, u32 numa_id) {
+      const auto lower = num_vertices * thread_id / loop::num_threads;
+      const auto upper = num_vertices * (thread_id + 1) / loop::num_threads;
+      for (u64 v = lower; v < upper; ++v) {
+        reordered[new_ids[v]] = external_ids.empty() ? v : external_ids[v];
+      }
+    });
+    external_ids = std::move(reordered);
+    return new_ids;
+  }
+
+  // weights are kept per out-edge, so a weighted graph keeps all of its CSRs
+  // and all edges
+  template <class Graph, class ID>
+  static Graph from_edge_list(std::vector<std::pair<ID, ID>> &edge_list,
+                              const std::vector<f32> *weights,
+                              const LoadOptions &options) {
+    if (weights == nullptr || weights->empty()) {
+      return Graph::from_edge_list(edge_list, options.direction,
+                                   options.cleanup);
+    }
+    if (options.cleanup.any()) {
+      throw std::invalid_argument(
+          "duplicates and self-loops cannot be removed from weighted edges");
+    }
+    return Graph::from_edge_list(edge_list, *weights);
+  }
+
+  template <class Graph>
+  static Graph load(const std::string &file_name,
+                    const LoadOptions &options = LoadOptions()) {
+    using ID = typename Graph::_ID;
+
+    if (options.snapshot_file.empty()) {
+      auto graph = build<Graph>(file_name, options);
+      compress(graph, options);
+      return graph;
+    }
+
+    // an image of the same source parsed otherwise (e.g. another format or
+    // without the weights this Graph keeps) is stale as well
+    const auto stamp = file_stamp(file_name);
+    const auto syntax = sniff_file(file_name, options.format);
+    const u64 e_prop_size =
+        syntax.has_weights && Graph::has_e_prop_column
+            ? sizeof(typename Graph::_EPropColumn)
+            : 0;
+    if (snapshot::is_fresh(
+            options.snapshot_file, sizeof(ID),
+            Graph::snapshot_flags(options.cleanup, options.reordering),
+            stamp.first, stamp.second, static_cast<u64>(syntax.format),
+            options.remap_ids || options.reordering != Reordering::None,
+            e_prop_size)) {
+      debug::logger->info("reuse snapshot: {}", options.snapshot_file);
+      auto graph = Graph::open(options.snapshot_file, options.direction);
+      debug::point("loaded");
+      compress(graph, options);
+      return graph;
+    }
+
+    auto full = options;
+    full.direction = Direction::Both;
+    auto graph = build<Graph>(file_name, full);
+    graph.save(options.snapshot_file, stamp.first, stamp.second,
+               static_cast<u64>(syntax.format));
+    debug::logger->info("saved snapshot: {}", options.snapshot_file);
+    compress(graph, options);
+    return graph;
+  }
+
+  template <class Graph>
+  static void compress(Graph &graph, const LoadOptions &options) {
+    if (!options.compress) {
+      return;
+    }
+    if (options.direction != Direction::In) {
+      throw std::invalid_argument(
+          "compressed in-edges are only walked by in-only kernels");
+    }
+    graph.compress_in_indices();
+  }
+
   /*
   static vector<pair<u32, u32>> fromFile(const std::string &file_name) {
       ifstream ifs(file_name, ios::in);
@@ -1,6 +1,7 @@
 #ifndef HOSHIZORA_KERNEL_H
 #define HOSHIZORA_KERNEL_H
 
+#include "hoshizora/core/graph.h"
 #include "hoshizora/core/includes.h"
 
 namespace hoshizora {
@@ -9,6 +10,10 @@ template <class Graph> struct Kernel {
   using VData = typename Graph::_VData;
   using ID = typename Graph::_ID;
 
+  // In: pulled over in-edges, scatter is evaluated per in-edge and
+  // gather is not called. Both: scatter and gather over out-edges
+  static constexpr Direction direction = Direction::Both;
+
   virtual VData init(const ID src, const Graph &graph) const = 0;
 
   virtual EData scatter(const ID src, const ID dst, const VData v_val,
@@ -2,6 +2,7 @@
 #define HOSHIZORA_LOOP_H
 
 #include "hoshizora/core/colle.h"
+#include "hoshizora/core/fork_join_pool.h"
 #include "hoshizora/core/includes.h"
 
 namespace hoshizora {
@@ -10,32 +11,6 @@ namespace loop {
 
 // static void quit() { pool.quit(); }
 
-template <
-    class
-    Func /*(thread_id, numa_id, dst, global_idx, local_idx, global_offset)*/>
-static inline void
-each_index(const u32 *const boundaries,
-           const colle::DiscreteArray<u8> &compressed_indices,
-           const colle::DiscreteArray<u32> &offsets, Func f) {
-
-  auto acc_num_srcs = 0;
-  for (u32 thread_id = 0; thread_id < num_threads; ++thread_id) {
-    const auto numa_id = mock::thread_to_numa(thread_id);
-    const auto lower = boundaries[thread_id];
-    const auto upper = boundaries[thread_id + 1];
-    const auto num_inner_vertices = upper - lower;
-
-    compressed_indices.foreach (
-        thread_id, num_inner_vertices,
-        [=, &f](u32 i, u32 local_offset, u32 _global_idx, u32 local_idx,
-                u32 global_offset) {
-          f(thread_id, numa_id, i, local_offset, acc_num_srcs + _global_idx,
-            local_idx, global_offset);
-        });
-    acc_num_srcs += num_inner_vertices;
-  }
-}
-
 template <class Func>
 static inline void each_thread(const u32 *const boundaries, Func f) {
   for (u32 thread_id = 0; thread_id < num_threads; ++thread_id) {
@@ -74,6 +49,52 @@ static inline void each_thread0(const u32 *const boundaries, Func f) {
 }
  */
 
+static inline ForkJoinPool &fork_join_pool() {
+  static ForkJoinPool pool(num_threads);
+  return pool;
+}
+
+// runs `f` on all pinned workers at once and waits for all of them. a call
+// from inside a worker falls back to one-shot threads. the first exception
+// thrown by `f` is rethrown here after all of them are joined
+template <class Func /*(thread_id, numa_id)*/>
+static inline void fork_join(Func f) {
+  if (ForkJoinPool::in_worker()) {
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(num_threads);
+    threads.reserve(num_threads);
+    for (u32 thread_id = 0; thread_id < num_threads; ++thread_id) {
+      threads.emplace_back([&f, &errors, thread_id]() {
+        try {
+          f(thread_id, mock::thread_to_numa(thread_id));
+        } catch (...) {
+          errors[thread_id] = std::current_exception();
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    for (const auto &error : errors) {
+      if (error) {
+        std::rethrow_exception(error);
+      }
+    }
+    return;
+  }
+  fork_join_pool().run([&f](u32 thread_id) {
+    f(thread_id, mock::thread_to_numa(thread_id));
+  });
+}
+
+// each_thread with all threads at once, `f` must be thread-safe
+template <class Func /*(thread_id, numa_id, lower, upper)*/>
+static inline void parallel_each_thread(const u32 *const boundaries, Func f) {
+  fork_join([&](u32 thread_id, u32 numa_id) {
+    f(thread_id, numa_id, boundaries[thread_id], boundaries[thread_id + 1]);
+  });
+}
+
 template <class Func>
 static inline void each_numa(const u32 *const boundaries, Func f) {
   u32 numa_id = 0;
@@ -0,0 +1,65 @@
+#ifndef HOSHIZORA_MAPPED_FILE_H
+#define HOSHIZORA_MAPPED_FILE_H
+
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hoshizora/core/includes.h"
+
+namespace hoshizora {
+// mapping of a whole file, released on destruction.
+// a private writable mapping is copy-on-write and never touches the file
+struct MappedFile {
+  char *data = nullptr;
+  u64 size = 0;
+
+  explicit MappedFile(const std::string &file_name,
+                      const bool writable = false) {
+    const auto fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Cannot open " + file_name);
+    }
+    struct stat st {};
+    fstat(fd, &st);
+    size = static_cast<u64>(st.st_size);
+    if (size > 0) {
+      const auto prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+      const auto addr = mmap(nullptr, size, prot, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Cannot mmap " + file_name);
+      }
+      madvise(addr, size, MADV_WILLNEED);
+      data = static_cast<char *>(addr);
+    }
+    close(fd);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() {
+    if (data != nullptr) {
+      munmap(data, size);
+    }
+  }
+};
+
+// (size, mtime) of a file, or (0, 0) if it does not exist
+static inline std::pair<u64, i64> file_stamp(const std::string &file_name) {
+  struct stat st {};
+  if (stat(file_name.c_str(), &st) != 0) {
+    return std::make_pair(0ul, 0l);
+  }
+  return std::make_pair(static_cast<u64>(st.st_size),
+                        static_cast<i64>(st.st_mtime));
+}
+} // namespace hoshizora
+
+#endif // HOSHIZORA_MAPPED_FILE_H
@@ -0,0 +1,185 @@
+#ifndef HOSHIZORA_OUTPUT_H
+#define HOSHIZORA_OUTPUT_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "hoshizora/core/colle.h"
+#include "hoshizora/core/includes.h"
+#include "hoshizora/core/loop.h"
+
+namespace hoshizora {
+namespace output {
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "binary output is written as is");
+
+enum class Mode {
+  Text,   // `value` or `external id<TAB>value` per line
+  Binary, // [external ids as u64 (if remapped)][values], little-endian
+};
+
+static inline Mode parse_mode(const std::string &name) {
+  if (name.empty() || name == "text") {
+    return Mode::Text;
+  }
+  if (name == "bin") {
+    return Mode::Binary;
+  }
+  throw std::invalid_argument("Unknown output format: " + name);
+}
+
+// upper bound of a formatted line (`%lu\t%f\n` of a double)
+constexpr u64 MAX_LINE_LENGTH = 20 + 1 + 320 + 1;
+
+static inline char *format_uint(char *p, u64 value) {
+  char digits[20];
+  u32 n = 0;
+  do {
+    digits[n++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (n > 0) {
+    *p++ = digits[--n];
+  }
+  return p;
+}
+
+template <class T>
+static inline typename std::enable_if<std::is_integral<T>::value, char *>::type
+format(char *p, const T value) {
+  if (value < 0) {
+    *p++ = '-';
+    return format_uint(p, static_cast<u64>(-static_cast<i64>(value)));
+  }
+  return format_uint(p, static_cast<u64>(value));
+}
+
+// same digits as std::to_string (`%f`). f32 * 1e6 is exact in f64 (24 + 14
+// bits of mantissa), so rounding it once matches the correctly rounded
+// `%f` including ties to even
+static inline char *format(char *p, const f32 value) {
+  const auto scaled = std::nearbyint(static_cast<f64>(value) * 1e6);
+  if (!(std::fabs(scaled) < 1e19)) {
+    return p + std::sprintf(p, "%f", value); // also inf and nan
+  }
+  if (std::signbit(value)) {
+    *p++ = '-';
+  }
+  const auto units = static_cast<u64>(std::fabs(scaled));
+  p = format_uint(p, units / 1000000);
+  *p++ = '.';
+  auto fraction = units % 1000000;
+  for (i32 i = 5; i >= 0; --i) {
+    p[i] = static_cast<char>('0' + fraction % 10);
+    fraction /= 10;
+  }
+  return p + 6;
+}
+
+static inline char *format(char *p, const f64 value) {
+  return p + std::sprintf(p, "%f", value);
+}
+
+// writes all of `iovecs` by as few writev calls as possible
+static inline void write_all(const int fd, std::vector<iovec> iovecs) {
+  u64 head = 0;
+  while (head < iovecs.size()) {
+    const auto n = std::min<u64>(iovecs.size() - head, IOV_MAX);
+    const auto written = writev(fd, iovecs.data() + head, static_cast<int>(n));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Cannot write results: " +
+                               std::string(std::strerror(errno)));
+    }
+    auto rest = static_cast<u64>(written);
+    while (head < iovecs.size() && rest >= iovecs[head].iov_len) {
+      rest -= iovecs[head].iov_len;
+      head++;
+    }
+    if (rest > 0) {
+      iovecs[head].iov_base = static_cast<char *>(iovecs[head].iov_base) + rest;
+      iovecs[head].iov_len -= rest;
+    }
+  }
+}
+
+/*
+ * Writes `values` ([#rows] in any chunking) to `fd`.
+ *
+ * Text mode formats an even slice of rows per thread into its own buffer
+ * and writes all buffers in order at once. Binary mode writes the chunks
+ * themselves without any conversion.
+ */
+template <class T>
+static void write(const int fd, const Mode mode,
+                  const colle::DiscreteArray<T> &values,
+                  const std::vector<u64> &external_ids) {
+  static_assert(std::is_arithmetic<T>::value, "values must be arithmetic");
+  const u64 num_rows = values.range.back();
+  assert(external_ids.empty() || external_ids.size() == num_rows);
+
+  if (mode == Mode::Binary) {
+    std::vector<iovec> iovecs;
+    if (!external_ids.empty()) {
+      iovecs.push_back({const_cast<u64 *>(external_ids.data()),
+                        sizeof(u64) * external_ids.size()});
+    }
+    for (u32 n = 0; n < values.data.size(); ++n) {
+      iovecs.push_back(
+          {values.data[n], sizeof(T) * (values.range[n + 1] - values.range[n])});
+    }
+    write_all(fd, std::move(iovecs));
+    return;
+  }
+
+  const auto num_threads = loop::num_threads;
+  std::vector<std::vector<char>> buffers(num_threads);
+  loop::fork_join([&](u32 thread_id, u32 numa_id) {
+    const u64 lower = num_rows * thread_id / num_threads;
+    const u64 upper = num_rows * (thread_id + 1) / num_threads;
+    auto &buffer = buffers[thread_id];
+    // ~16 bytes per line is common, grown on demand
+    buffer.resize((upper - lower) * 16 + MAX_LINE_LENGTH);
+    u64 length = 0;
+
+    // looked up at the first row, then walks chunks sequentially
+    auto value = values.at(lower);
+    for (auto row = lower; row < upper; ++row, ++value) {
+      if (buffer.size() - length < MAX_LINE_LENGTH) {
+        buffer.resize(buffer.size() * 2);
+      }
+      auto p = buffer.data() + length;
+      if (!external_ids.empty()) {
+        p = format_uint(p, external_ids[row]);
+        *p++ = '\t';
+      }
+      p = format(p, *value);
+      *p++ = '\n';
+      length = static_cast<u64>(p - buffer.data());
+    }
+    buffer.resize(length);
+  });
+
+  std::vector<iovec> iovecs;
+  for (auto &buffer : buffers) {
+    iovecs.push_back({buffer.data(), buffer.size()});
+  }
+  write_all(fd, std::move(iovecs));
+}
+} // namespace output
+} // namespace hoshizora
+
+#endif // HOSHIZORA_OUTPUT_H
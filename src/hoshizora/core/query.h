@@ -0,0 +1,130 @@
+#ifndef HOSHIZORA_QUERY_H
+#define HOSHIZORA_QUERY_H
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hoshizora/core/colle.h"
+#include "hoshizora/core/includes.h"
+#include "hoshizora/core/loop.h"
+
+namespace hoshizora {
+namespace query {
+/*
+ * Extracts (vertex, value) pairs from per-vertex values without touching
+ * the rest. Each thread selects from its own chunks first and only the
+ * partial results are merged.
+ */
+
+// larger value first, then smaller vertex
+template <class ID, class T>
+static inline bool ranks_higher(const std::pair<ID, T> &l,
+                                const std::pair<ID, T> &r) {
+  return r.second < l.second || (!(l.second < r.second) && l.first < r.first);
+}
+
+// calls f(n) for each chunk n of `values` owned by the thread
+template <class T, class Func /*(chunk)*/>
+static inline void each_chunk(const colle::DiscreteArray<T> &values,
+                              const u32 thread_id, Func f) {
+  for (u32 n = thread_id; n < values.data.size(); n += loop::num_threads) {
+    f(n);
+  }
+}
+
+template <class T, class ID, class Select /*(chunk, partial)*/>
+static std::vector<std::pair<ID, T>>
+select(const colle::DiscreteArray<T> &values, Select select_chunk) {
+  std::vector<std::vector<std::pair<ID, T>>> partials(loop::num_threads);
+  loop::fork_join([&](u32 thread_id, u32 numa_id) {
+    each_chunk(values, thread_id,
+               [&](u32 n) { select_chunk(n, partials[thread_id]); });
+  });
+
+  std::vector<std::pair<ID, T>> merged;
+  for (auto &partial : partials) {
+    merged.insert(merged.end(), partial.begin(), partial.end());
+  }
+  return merged;
+}
+
+// k highest values, highest first
+template <class ID, class T>
+static std::vector<std::pair<ID, T>>
+top_k(const colle::DiscreteArray<T> &values, const u64 k) {
+  using Pair = std::pair<ID, T>;
+  if (k == 0) {
+    return std::vector<Pair>();
+  }
+
+  // bounded heap per thread whose top is the lowest of the kept pairs
+  auto merged = select<T, ID>(values, [&](u32 n, std::vector<Pair> &heap) {
+    const auto chunk = values.data[n];
+    const auto offset = values.range[n];
+    for (u32 i = 0, end = values.range[n + 1] - offset; i < end; ++i) {
+      const auto candidate = Pair(static_cast<ID>(offset + i), chunk[i]);
+      if (heap.size() < k) {
+        heap.push_back(candidate);
+        std::push_heap(heap.begin(), heap.end(), ranks_higher<ID, T>);
+      } else if (ranks_higher(candidate, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), ranks_higher<ID, T>);
+        heap.back() = candidate;
+        std::push_heap(heap.begin(), heap.end(), ranks_higher<ID, T>);
+      }
+    }
+  });
+
+  const auto num_selected = std::min<u64>(k, merged.size());
+  std::partial_sort(merged.begin(), merged.begin() + num_selected,
+                    merged.end(), ranks_higher<ID, T>);
+  merged.resize(num_selected);
+  return merged;
+}
+
+// values not lower than `min`, in vertex order
+template <class ID, class T>
+static std::vector<std::pair<ID, T>>
+threshold(const colle::DiscreteArray<T> &values, const T min) {
+  using Pair = std::pair<ID, T>;
+  // chunks of a thread are strided, so partials are sorted afterwards
+  auto merged = select<T, ID>(values, [&](u32 n, std::vector<Pair> &partial) {
+    const auto chunk = values.data[n];
+    const auto offset = values.range[n];
+    for (u32 i = 0, end = values.range[n + 1] - offset; i < end; ++i) {
+      if (!(chunk[i] < min)) {
+        partial.emplace_back(static_cast<ID>(offset + i), chunk[i]);
+      }
+    }
+  });
+  std::sort(merged.begin(), merged.end(),
+            [](const Pair &l, const Pair &r) { return l.first < r.first; });
+  return merged;
+}
+
+// values of `vertices` in the given order
+template <class ID, class T>
+static std::vector<std::pair<ID, T>>
+subset(const colle::DiscreteArray<T> &values, const std::vector<ID> &vertices) {
+  const auto num_vertices = vertices.size();
+  for (const auto v : vertices) {
+    if (v >= values.range.back()) {
+      throw std::out_of_range("No such vertex: " + std::to_string(v));
+    }
+  }
+  std::vector<std::pair<ID, T>> selected(num_vertices);
+  loop::fork_join([&](u32 thread_id, u32 numa_id) {
+    const auto lower = num_vertices * thread_id / loop::num_threads;
+    const auto upper = num_vertices * (thread_id + 1) / loop::num_threads;
+    for (u64 i = lower; i < upper; ++i) {
+      selected[i] = std::make_pair(vertices[i], values(vertices[i]));
+    }
+  });
+  return selected;
+}
+} // namespace query
+} // namespace hoshizora
+
+#endif // HOSHIZORA_QUERY_H
@@ -0,0 +1,174 @@
+#ifndef HOSHIZORA_SNAPSHOT_H
+#define HOSHIZORA_SNAPSHOT_H
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hoshizora/core/includes.h"
+
+namespace hoshizora {
+namespace snapshot {
+/*
+ * Binary image of a built Graph, mmapped as is by Graph::open
+ *
+ * [header | boundaries | out_offsets | out_indices |
+ *                         in_offsets  | in_indices  | forward_indices |
+ *           external_ids (if remapped or reordered) |
+ *           out_e_props (if parsed)]
+ *
+ * both directions share the boundaries (header.in_boundaries points to
+ * out_boundaries). an undirected graph writes the out-sections only and the
+ * in-ones point to them, its forward_indices are the reverse slots.
+ * every section starts at a multiple of ALIGNMENT, offsets are global
+ * (#vertices + 1 with cap) and boundaries are for `num_threads` threads.
+ */
+constexpr char MAGIC[8] = {'H', 'Z', 'C', 'S', 'R', 0, 0, 0};
+constexpr u32 VERSION = 7;
+// Header::flags
+constexpr u32 UNDIRECTED = 1; // in-sections are the out-sections
+constexpr u32 NO_DUPLICATES = 2;
+constexpr u32 NO_SELF_LOOPS = 4;
+constexpr u32 REORDERING_SHIFT = 8; // Reordering in bits 8-15
+constexpr u64 ALIGNMENT = 64;
+
+struct Header {
+  char magic[8];
+  u32 version;
+  u32 id_size;
+  u64 num_vertices;
+  u64 num_edges;
+  u32 num_threads;
+  u32 flags;
+  // stamp of the file the graph was built from, to detect stale snapshots
+  u64 source_size;
+  i64 source_mtime;
+  // Format (io.h) the source was parsed as, resolved from Format::Auto
+  u64 format;
+  // byte offsets of sections from the head of the file
+  u64 out_boundaries;
+  u64 out_offsets;
+  u64 out_indices;
+  u64 in_boundaries;
+  u64 in_offsets;
+  u64 in_indices;
+  u64 forward_indices;
+  u64 external_ids;
+  u64 num_external_ids;
+  u64 out_e_props;
+  u64 e_prop_size; // sizeof(EProp), 0 without out_e_props
+  u64 file_size;
+};
+
+static inline u64 align(const u64 pos) {
+  return (pos + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+static inline bool is_valid(const Header &header, const u32 id_size,
+                            const bool is_directed) {
+  return std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+         header.version == VERSION && header.id_size == id_size &&
+         ((header.flags & UNDIRECTED) == 0) == is_directed;
+}
+
+// true if `file_name` is a whole snapshot of this version built with `flags`
+// from a source of the given size and mtime parsed as `format`, with or
+// without external IDs and with out_e_props of `e_prop_size` bytes each
+// (0: none)
+static inline bool is_fresh(const std::string &file_name, const u32 id_size,
+                            const u32 flags, const u64 source_size,
+                            const i64 source_mtime, const u64 format,
+                            const bool has_ids, const u64 e_prop_size) {
+  struct stat st {};
+  std::ifstream ifs(file_name, std::ios::in | std::ios::binary);
+  if (!ifs || stat(file_name.c_str(), &st) != 0) {
+    return false;
+  }
+  Header header{};
+  ifs.read(reinterpret_cast<char *>(&header), sizeof(Header));
+  return ifs.gcount() == sizeof(Header) &&
+         header.file_size == static_cast<u64>(st.st_size) &&
+         is_valid(header, id_size, (flags & UNDIRECTED) == 0) &&
+         header.flags == flags &&
+         header.source_size == source_size &&
+         header.source_mtime == source_mtime && header.format == format &&
+         (header.num_external_ids > 0) == has_ids &&
+         header.e_prop_size == e_prop_size;
+}
+
+/*
+ * sequential writer which pads each section up to ALIGNMENT. the image is
+ * written to a temporary file next to `file_name` and renamed over it by
+ * commit() once it is on disk, so that a crash, a full disk or another job
+ * saving at the same time never leaves a partial snapshot behind
+ */
+struct Writer {
+  const std::string file_name;
+  const std::string tmp_file_name;
+  std::ofstream ofs;
+  u64 pos = 0;
+  bool committed = false;
+
+  explicit Writer(const std::string &file_name)
+      : file_name(file_name),
+        tmp_file_name(file_name + ".tmp." + std::to_string(getpid())),
+        ofs(tmp_file_name, std::ios::out | std::ios::binary | std::ios::trunc) {
+    if (!ofs) {
+      throw std::runtime_error("Cannot create " + tmp_file_name);
+    }
+  }
+
+  ~Writer() {
+    if (!committed) {
+      discard();
+    }
+  }
+
+  // drops the temporary file, also when the exception is never caught
+  void discard() {
+    ofs.close();
+    std::remove(tmp_file_name.c_str());
+  }
+
+  void write(const void *data, const u64 size) {
+    ofs.write(static_cast<const char *>(data), size);
+    if (!ofs) {
+      discard();
+      throw std::runtime_error("Cannot write " + tmp_file_name);
+    }
+    pos += size;
+  }
+
+  void commit() {
+    ofs.close();
+    if (!ofs) {
+      discard();
+      throw std::runtime_error("Cannot write " + tmp_file_name);
+    }
+    const auto fd = ::open(tmp_file_name.c_str(), O_RDONLY);
+    const bool synced = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    if (!synced || std::rename(tmp_file_name.c_str(), file_name.c_str()) != 0) {
+      discard();
+      throw std::runtime_error("Cannot write " + file_name);
+    }
+    committed = true;
+  }
+
+  void pad() {
+    static const char zeros[ALIGNMENT] = {};
+    const auto padded = align(pos);
+    write(zeros, padded - pos);
+  }
+};
+} // namespace snapshot
+} // namespace hoshizora
+
+#endif // HOSHIZORA_SNAPSHOT_H
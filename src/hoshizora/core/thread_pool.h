@@ -3,6 +3,7 @@
 
 #include <condition_variable>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
@@ -17,7 +18,7 @@
 namespace hoshizora {
 struct ThreadPool {
   std::vector<std::thread> pool;
-  std::vector<std::queue<std::function<void()>> *> task_queues;
+  std::vector<std::unique_ptr<std::queue<std::function<void()>>>> task_queues;
   bool quit_flag = false;
   bool force_quit_flag = false;
   u32 num_threads;
@@ -26,7 +27,8 @@ struct ThreadPool {
 
   explicit ThreadPool() : num_threads(loop::num_threads) {
     for (u32 thread_id = 0; thread_id < num_threads; ++thread_id) {
-      auto queue = new std::queue<std::function<void()>>();
+      std::unique_ptr<std::queue<std::function<void()>>> queue(
+          new std::queue<std::function<void()>>());
 #ifdef __linux__
       queue->push([&, thread_id]() {
         cpu_set_t cpuset;
@@ -46,7 +48,7 @@ struct ThreadPool {
       debug::logger->info("No thread affinity")
 #endif
       });
-      task_queues.emplace_back(queue);
+      task_queues.emplace_back(std::move(queue));
     }
 
     for (u32 thread_id = 0; thread_id < num_threads; ++thread_id) {
@@ -77,23 +79,28 @@ struct ThreadPool {
     }
   }
 
-  void push_tasks(std::vector<std::function<void()>> *tasks) {
-    assert(num_threads == tasks->size());
+  void push_tasks(std::vector<std::function<void()>> &&tasks) {
+    assert(num_threads == tasks.size());
 
     for (u32 n = 0; n < num_threads; ++n) {
       mtx.lock();
-      task_queues[n]->push(std::move((*tasks)[n]));
+      task_queues[n]->push(std::move(tasks[n]));
       mtx.unlock();
     }
 
     cond.notify_all();
   }
 
+  // lets workers finish queued tasks unless quit already
+  ~ThreadPool() { quit(); }
+
   void quit() {
     quit_flag = true;
     cond.notify_all();
     for (auto &thread : pool) {
-      thread.join();
+      if (thread.joinable()) {
+        thread.join();
+      }
     }
   }
 
@@ -101,7 +108,9 @@ struct ThreadPool {
     force_quit_flag = true;
     cond.notify_all();
     for (auto &thread : pool) {
-      thread.join();
+      if (thread.joinable()) {
+        thread.join();
+      }
     }
   }
 }; // namespace hoshizora
@@ -0,0 +1,191 @@
+#ifndef HOSHIZORA_TOKENIZER_H
+#define HOSHIZORA_TOKENIZER_H
+
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "hoshizora/core/includes.h"
+
+namespace hoshizora {
+namespace tokenizer {
+/*
+ * AVX2/SSE helpers for text edge lists.
+ * Every function takes [head, tail) and never reads at or beyond `tail`;
+ * vector paths are used only if a whole register fits before `tail`.
+ */
+static inline bool is_digit(const char c) {
+  return static_cast<u8>(c - '0') < 10u;
+}
+
+static inline bool is_blank(const char c) {
+  return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+// bit i is set if p[i] is a digit
+static inline u32 digit_mask(const char *const p) {
+  const auto v = _mm256_sub_epi8(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)),
+      _mm256_set1_epi8('0'));
+  const auto is_digit =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(9)), v);
+  return static_cast<u32>(_mm256_movemask_epi8(is_digit));
+}
+
+// head of the next line, or tail
+static inline const char *next_line(const char *head, const char *const tail) {
+  const auto nl = _mm256_set1_epi8('\n');
+  for (; head + 32 <= tail; head += 32) {
+    const auto mask = static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(head)), nl)));
+    if (mask != 0) {
+      return head + __builtin_ctz(mask) + 1;
+    }
+  }
+  const auto p = static_cast<const char *>(
+      std::memchr(head, '\n', static_cast<size_t>(tail - head)));
+  return p == nullptr ? tail : p + 1;
+}
+
+// #digits from head
+static inline u32 count_digits(const char *const head,
+                               const char *const tail) {
+  if (head + 32 <= tail) {
+    const auto non_digits = ~digit_mask(head);
+    if (non_digits != 0) {
+      return __builtin_ctz(non_digits);
+    }
+  }
+  u32 n = 0;
+  while (head + n < tail && is_digit(head[n])) {
+    n++;
+  }
+  return n;
+}
+
+/*
+ * right-aligns `length` (<= 16) bytes loaded from a token head, e.g.
+ * length 3: [d0 d1 d2 x x ...] -> [0 ... 0 d0 d1 d2]
+ */
+struct AlignTable {
+  alignas(16) u8 shuffles[17][16];
+
+  AlignTable() {
+    for (u32 length = 0; length <= 16; ++length) {
+      for (u32 i = 0; i < 16; ++i) {
+        shuffles[length][i] =
+            i < 16 - length ? 0x80u : static_cast<u8>(i - (16 - length));
+      }
+    }
+  }
+};
+static const AlignTable align_table;
+
+// up to 16 digits at once: 1-digit lanes are folded into 2-, 4- and then
+// 8-digit lanes by multiply-adds
+static inline u64 parse_digits16(const char *const head, const u32 length) {
+  assert(length <= 16);
+  const auto digits = _mm_shuffle_epi8(
+      _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(head)),
+                   _mm_set1_epi8('0')),
+      _mm_load_si128(
+          reinterpret_cast<const __m128i *>(align_table.shuffles[length])));
+  const auto x2 = _mm_maddubs_epi16(
+      digits, _mm_set_epi8(1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10,
+                           1, 10));
+  const auto x4 =
+      _mm_madd_epi16(x2, _mm_set_epi16(1, 100, 1, 100, 1, 100, 1, 100));
+  const auto x8 = _mm_madd_epi16(_mm_packus_epi32(x4, x4),
+                                 _mm_set_epi16(1, 10000, 1, 10000, 1, 10000,
+                                               1, 10000));
+  const auto hi = static_cast<u64>(static_cast<u32>(_mm_cvtsi128_si32(x8)));
+  const auto lo =
+      static_cast<u64>(static_cast<u32>(_mm_extract_epi32(x8, 1)));
+  return hi * 100000000ul + lo;
+}
+
+// parses an unsigned integer at head, which must be a digit. a value T
+// cannot hold is an error reported with the line starting at `line`
+template <class T>
+static inline const char *parse_uint(const char *head, const char *const tail,
+                                     T &value, const char *const line) {
+  const auto length = count_digits(head, tail);
+  u64 acc = 0;
+  bool overflow = length > 20; // u64 has 20 digits at most
+  if (length <= 16 && head + 16 <= tail) {
+    acc = parse_digits16(head, length);
+  } else {
+    for (u32 i = 0; i < length && !overflow; ++i) {
+      overflow = __builtin_mul_overflow(acc, 10u, &acc) ||
+                 __builtin_add_overflow(acc, static_cast<u64>(head[i] - '0'),
+                                        &acc);
+    }
+  }
+  if (overflow || acc > std::numeric_limits<T>::max()) {
+    const auto end = next_line(line, tail);
+    throw std::runtime_error(
+        "ID out of range in line: " +
+        std::string(line, end > line && end[-1] == '\n' ? end - 1 : end));
+  }
+  value = static_cast<T>(acc);
+  return head + length;
+}
+
+// `[-]digits[.digits]` is parsed as integers, anything else (exponents,
+// inf, very long mantissas) by strtof
+static inline const char *parse_float(const char *head, const char *const tail,
+                                      f32 &value) {
+  static constexpr f64 inv_pow10[17] = {
+      1e-0, 1e-1, 1e-2,  1e-3,  1e-4,  1e-5,  1e-6,  1e-7, 1e-8,
+      1e-9, 1e-10, 1e-11, 1e-12, 1e-13, 1e-14, 1e-15, 1e-16};
+
+  const auto start = head;
+  const bool negative = head < tail && *head == '-';
+  if (negative) {
+    head++;
+  }
+
+  u64 integral = 0;
+  auto p = head;
+  const auto num_integral = count_digits(p, tail);
+  if (num_integral <= 16 && p + 16 <= tail) {
+    integral = parse_digits16(p, num_integral);
+    p += num_integral;
+
+    f64 fraction = 0;
+    if (p < tail && *p == '.') {
+      p++;
+      const auto num_fraction = count_digits(p, tail);
+      if (num_fraction <= 16 && p + 16 <= tail) {
+        fraction = parse_digits16(p, num_fraction) * inv_pow10[num_fraction];
+        p += num_fraction;
+      } else {
+        p = nullptr;
+      }
+    }
+
+    if (p != nullptr && (p == tail || !(*p == 'e' || *p == 'E'))) {
+      const auto abs = static_cast<f64>(integral) + fraction;
+      value = static_cast<f32>(negative ? -abs : abs);
+      return p;
+    }
+  }
+
+  // fallback on a NUL-terminated copy since the input is not terminated
+  char buffer[64];
+  auto end = start;
+  while (end < tail && end - start < 63 && !is_blank(*end) && *end != '\n') {
+    end++;
+  }
+  std::memcpy(buffer, start, static_cast<size_t>(end - start));
+  buffer[end - start] = '\0';
+  value = std::strtof(buffer, nullptr);
+  return end;
+}
+} // namespace tokenizer
+} // namespace hoshizora
+
+#endif // HOSHIZORA_TOKENIZER_H
@@ -1,23 +1,346 @@
 #include "hoshizora/app/apps.h"
+#include "hoshizora/core/id_map.h"
+#include <cstring>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
 namespace hoshizora {
-PYBIND11_MODULE(hoshizora, m) {
-  namespace py = pybind11;
+namespace py = pybind11;
+
+static LoadOptions load_options(const std::string &snapshot,
+                                const u64 memory_budget,
+                                const std::string &spill_dir,
+                                const bool remap_ids,
+                                const std::string &input_format,
+                                const bool dedup,
+                                const bool drop_self_loops,
+                                const std::string &reorder) {
+  LoadOptions options;
+  options.format = parse_format(input_format);
+  options.snapshot_file = snapshot;
+  options.memory_budget = memory_budget;
+  options.spill_dir = spill_dir;
+  options.remap_ids = remap_ids;
+  options.cleanup.duplicates = dedup;
+  options.cleanup.self_loops = drop_self_loops;
+  options.reordering = parse_reordering(reorder);
+  return options;
+}
+
+static ResultQuery result_query(const u64 top_k, const py::object &threshold,
+                                const std::vector<u64> &vertices) {
+  ResultQuery query;
+  query.top_k = top_k;
+  if (!threshold.is_none()) {
+    query.threshold = threshold.cast<f32>();
+  }
+  query.vertices = vertices;
+  return query;
+}
+
+// hands `values` over to a NumPy array. contiguous chunks are owned by the
+// array as they are, others are gathered by one parallel copy and released
+template <class T>
+static py::array_t<T> to_numpy(colle::DiscreteArray<T> &&values) {
+  const u64 length = values.range.back();
+  if (values.data.empty()) {
+    return py::array_t<T>(py::ssize_t(0));
+  }
+  if (values.is_contiguous()) {
+    const auto data = values.data[0];
+    const auto owner = new colle::DiscreteArray<T>(std::move(values));
+    return py::array_t<T>(
+        static_cast<py::ssize_t>(length), data, py::capsule(owner, [](void *p) {
+          delete static_cast<colle::DiscreteArray<T> *>(p);
+        }));
+  }
+
+  auto array = py::array_t<T>(static_cast<py::ssize_t>(length));
+  const auto out = array.mutable_data();
+  loop::fork_join([&](u32 thread_id, u32 numa_id) {
+    query::each_chunk(values, thread_id, [&](u32 n) {
+      const auto size = sizeof(T) * (values.range[n + 1] - values.range[n]);
+      std::memcpy(out + values.range[n], values.data[n], size);
+    });
+  });
+  values.clear();
+  return array;
+}
+
+template <class T> static py::array_t<T> to_numpy(std::vector<T> &&values) {
+  const auto owner = new std::vector<T>(std::move(values));
+  return py::array_t<T>(static_cast<py::ssize_t>(owner->size()), owner->data(),
+                        py::capsule(owner, [](void *p) {
+                          delete static_cast<std::vector<T> *>(p);
+                        }));
+}
+
+// (original IDs, values) if remapped, otherwise values only
+template <class T>
+static py::object with_ids(const std::vector<u64> &external_ids,
+                           py::array_t<T> values) {
+  if (external_ids.empty()) {
+    return std::move(values);
+  }
+  return py::make_tuple(to_numpy(std::vector<u64>(external_ids)), values);
+}
+
+// takes the final scores over from the graph of a finished run
+template <class Executor>
+static py::object take_scores(const Executor &executor) {
+  auto &graph = *executor.curr_graph;
+  auto scores = to_numpy(std::move(graph.v_data));
+  graph.v_data.clear();
+  return with_ids(graph.external_ids, std::move(scores));
+}
 
+// (original IDs, scores) of the selected vertices in the selected order
+static py::tuple to_numpy(const std::vector<std::pair<u64, f32>> &selected) {
+  std::vector<u64> ids(selected.size());
+  std::vector<f32> scores(selected.size());
+  for (u64 i = 0; i < selected.size(); ++i) {
+    ids[i] = selected[i].first;
+    scores[i] = selected[i].second;
+  }
+  return py::make_tuple(to_numpy(std::move(ids)), to_numpy(std::move(scores)));
+}
+
+// calls f(data, length) on a 1-d integer array as it is, without a
+// conversion copy. signed arrays are read as unsigned of the same width
+template <class Func /*(data, length)*/>
+static auto with_indices(const py::array &array, const char *name, Func f) {
+  const auto contiguous = py::array::ensure(array, py::array::c_style);
+  const auto kind = contiguous ? contiguous.dtype().kind() : '\0';
+  if (!contiguous || contiguous.ndim() != 1 || (kind != 'i' && kind != 'u')) {
+    throw std::invalid_argument(std::string(name) +
+                                " must be a 1-d integer array");
+  }
+  const auto length = static_cast<u64>(contiguous.size());
+  switch (contiguous.itemsize()) {
+  case 4:
+    return f(static_cast<const u32 *>(contiguous.data()), length);
+  case 8:
+    return f(static_cast<const u64 *>(contiguous.data()), length);
+  default:
+    throw std::invalid_argument(std::string(name) +
+                                " must be of 32 or 64-bit integers");
+  }
+}
+
+// pairs up `srcs` and `dsts` by a single parallel copy
+template <class ID, class Src, class Dst>
+static std::vector<std::pair<ID, ID>>
+zip_edges(const Src *const srcs, const Dst *const dsts, const u64 num_edges) {
+  std::vector<std::pair<ID, ID>> edge_list(num_edges);
+  loop::fork_join([&](u32 thread_id, u32 numa_id) {
+    const auto lower = num_edges * thread_id / loop::num_threads;
+    const auto upper = num_edges * (thread_id + 1) / loop::num_threads;
+    for (u64 i = lower; i < upper; ++i) {
+      edge_list[i] =
+          std::make_pair(static_cast<ID>(srcs[i]), static_cast<ID>(dsts[i]));
+    }
+  });
+  return edge_list;
+}
+
+static PageRankGraph from_edges(const py::array &src, const py::array &dst,
+                                const bool remap_ids) {
+  return with_indices(src, "src", [&](auto srcs, const u64 num_edges) {
+    return with_indices(dst, "dst", [&](auto dsts, const u64 num_dsts) {
+      if (num_edges == 0 || num_edges != num_dsts) {
+        throw std::invalid_argument(
+            "src and dst must be non-empty and of the same length");
+      }
+      if (!remap_ids) {
+        auto edge_list = zip_edges<u32>(srcs, dsts, num_edges);
+        return PageRankGraph::from_edge_list(edge_list);
+      }
+      std::vector<u64> external_ids;
+      auto edge_list = IdMap<u32>::remap(zip_edges<u64>(srcs, dsts, num_edges),
+                                         external_ids);
+      auto graph = PageRankGraph::from_edge_list(edge_list);
+      graph.external_ids = std::move(external_ids);
+      return graph;
+    });
+  });
+}
+
+// `num_vertices` is widened to cover all rows and indices
+static PageRankGraph from_csr(const py::array &indptr, const py::array &indices,
+                              const u64 num_vertices) {
+  return with_indices(indptr, "indptr", [&](auto offsets, const u64 length) {
+    return with_indices(indices, "indices", [&](auto dsts,
+                                                const u64 num_edges) {
+      if (length == 0 || offsets[0] != 0 ||
+          offsets[length - 1] != num_edges) {
+        throw std::invalid_argument("indptr does not match indices");
+      }
+      u64 max_dst = 0;
+      for (u64 i = 0; i < num_edges; ++i) {
+        max_dst = std::max<u64>(max_dst, dsts[i]);
+      }
+      const auto num_rows = length - 1;
+      const auto n = std::max(std::max(num_vertices, num_rows),
+                              num_edges > 0 ? max_dst + 1 : 0);
+      if (n >= std::numeric_limits<u32>::max() ||
+          num_edges >= std::numeric_limits<u32>::max()) {
+        throw std::invalid_argument("graph is too large for 32-bit IDs");
+      }
+      return PageRankGraph::from_csr(offsets, dsts, num_rows, n);
+    });
+  });
+}
+
+PYBIND11_MODULE(hoshizora, m) {
   m.doc() = "hoshizora: Fast graph analysis engine";
+
+  // built once and kept resident, so several algorithms can run on it
+  py::class_<PageRankGraph>(m, "Graph")
+      .def_static("from_edges", &from_edges, py::arg("src"), py::arg("dst"),
+                  py::arg("remap_ids") = false)
+      .def_static("from_csr", &from_csr, py::arg("indptr"),
+                  py::arg("indices"), py::arg("num_vertices") = 0)
+      .def_static("from_scipy",
+                  [](const py::object &matrix) {
+                    const auto csr = matrix.attr("tocsr")();
+                    const auto shape = csr.attr("shape").cast<py::tuple>();
+                    return from_csr(
+                        csr.attr("indptr").cast<py::array>(),
+                        csr.attr("indices").cast<py::array>(),
+                        std::max(shape[0].cast<u64>(), shape[1].cast<u64>()));
+                  },
+                  py::arg("matrix"))
+      .def_static("load",
+                  [](const std::string &file_name, const std::string &snapshot,
+                     const u64 memory_budget, const std::string &spill_dir,
+                     const bool remap_ids, const std::string &input_format,
+                     const bool dedup, const bool drop_self_loops,
+                     const std::string &reorder, const bool compress) {
+                    auto options = load_options(snapshot, memory_budget,
+                                                spill_dir, remap_ids,
+                                                input_format, dedup,
+                                                drop_self_loops, reorder);
+                    // a compressed graph is walked by pagerank only
+                    if (compress) {
+                      options.direction = Direction::In;
+                      options.compress = true;
+                    }
+                    return IO::load<PageRankGraph>(file_name, options);
+                  },
+                  py::arg("file_name"), py::arg("snapshot") = "",
+                  py::arg("memory_budget") = 0, py::arg("spill_dir") = "/tmp",
+                  py::arg("remap_ids") = false,
+                  py::arg("input_format") = "auto", py::arg("dedup") = false,
+                  py::arg("drop_self_loops") = false,
+                  py::arg("reorder") = "none", py::arg("compress") = false)
+      .def_property_readonly(
+          "num_vertices",
+          [](const PageRankGraph &graph) { return graph.num_vertices; })
+      .def_property_readonly(
+          "num_edges",
+          [](const PageRankGraph &graph) { return graph.num_edges; })
+      .def_property_readonly(
+          "memory_usage",
+          [](const PageRankGraph &graph) { return graph.memory_usage(); })
+      // original IDs of the sources of edges into `vertex`. a compressed
+      // graph decodes this list alone
+      .def("in_neighbors",
+           [](const PageRankGraph &graph, const u64 vertex) {
+             if (!graph.in_indices_is_initialized &&
+                 !graph.in_indices_is_compressed) {
+               throw std::invalid_argument("Graph has no in-edges");
+             }
+             const auto dst = graph.internal_id(vertex);
+             std::vector<u64> srcs;
+             srcs.reserve(graph.in_degree(dst));
+             graph.each_in_neighbor(dst, [&](const u32 src) {
+               srcs.emplace_back(graph.external_id(src));
+             });
+             return to_numpy(std::move(srcs));
+           },
+           py::arg("vertex"))
+      .def("pagerank",
+           [](PageRankGraph &graph, const u32 num_iters, const u64 top_k,
+              const py::object &threshold,
+              const std::vector<u64> &vertices) -> py::object {
+             if (top_k == 0 && threshold.is_none() && vertices.empty()) {
+               py::object scores;
+               with_pagerank(graph, num_iters, [&](const auto &executor) {
+                 scores = take_scores(executor);
+               });
+               return scores;
+             }
+             return to_numpy(pagerank(graph, num_iters,
+                                      result_query(top_k, threshold, vertices)));
+           },
+           py::arg("num_iters") = 50, py::arg("top_k") = 0,
+           py::arg("threshold") = py::none(),
+           py::arg("vertices") = std::vector<u64>())
+      .def("clustering",
+           [](const PageRankGraph &graph, const u32 num_clusters_hint,
+              const f64 threshold) -> py::object {
+             return with_ids(
+                 graph.external_ids,
+                 to_numpy(clustering(
+                     graph.rebind<f32, f32, std::pair<u32, f64>, f64>(),
+                     num_clusters_hint, threshold)));
+           },
+           py::arg("num_clusters_hint") = 100, py::arg("threshold") = 0.00003);
+
   m.def("pagerank",
-        [](const std::string &file_name, const u32 num_iters) {
-          return pagerank(file_name, num_iters);
+        [](const std::string &file_name, const u32 num_iters,
+           const std::string &snapshot, const u64 memory_budget,
+           const std::string &spill_dir, const bool remap_ids,
+           const std::string &input_format, const u64 top_k,
+           const py::object &threshold, const std::vector<u64> &vertices,
+           const bool dedup, const bool drop_self_loops,
+           const std::string &reorder, const bool compress) -> py::object {
+          auto options =
+              load_options(snapshot, memory_budget, spill_dir, remap_ids,
+                           input_format, dedup, drop_self_loops, reorder);
+          options.compress = compress;
+          if (top_k == 0 && threshold.is_none() && vertices.empty()) {
+            py::object scores;
+            with_pagerank(file_name, num_iters, options,
+                          [&](const auto &executor) {
+                            scores = take_scores(executor);
+                          });
+            return scores;
+          }
+          // (original IDs, scores) of the matching vertices only
+          return to_numpy(pagerank(file_name, num_iters, options,
+                                   result_query(top_k, threshold, vertices)));
         },
-        py::arg("file_name"), py::arg("num_iters") = 50);
+        py::arg("file_name"), py::arg("num_iters") = 50,
+        py::arg("snapshot") = "", py::arg("memory_budget") = 0,
+        py::arg("spill_dir") = "/tmp", py::arg("remap_ids") = false,
+        py::arg("input_format") = "auto", py::arg("top_k") = 0,
+        py::arg("threshold") = py::none(),
+        py::arg("vertices") = std::vector<u64>(), py::arg("dedup") = false,
+        py::arg("drop_self_loops") = false, py::arg("reorder") = "none",
+        py::arg("compress") = false);
   m.def("clustering",
         [](const std::string &file_name, const u32 num_clusters_hint,
-           const f64 threshold) {
-          return clustering(file_name, num_clusters_hint, threshold);
+           const f64 threshold, const std::string &snapshot,
+           const u64 memory_budget, const std::string &spill_dir,
+           const bool remap_ids, const std::string &input_format,
+           const bool dedup, const bool drop_self_loops,
+           const std::string &reorder) -> py::object {
+          std::vector<u64> external_ids;
+          auto clusters = clustering(
+              file_name, num_clusters_hint, threshold,
+              load_options(snapshot, memory_budget, spill_dir, remap_ids,
+                           input_format, dedup, drop_self_loops, reorder),
+              &external_ids);
+          // (original IDs, cluster IDs) in the same order if remapped
+          return with_ids(external_ids, to_numpy(std::move(clusters)));
         },
         py::arg("file_name"), py::arg("num_clusters_hint") = 100,
-        py::arg("threshold") = 0.00003);
+        py::arg("threshold") = 0.00003, py::arg("snapshot") = "",
+        py::arg("memory_budget") = 0, py::arg("spill_dir") = "/tmp",
+        py::arg("remap_ids") = false, py::arg("input_format") = "auto",
+        py::arg("dedup") = false, py::arg("drop_self_loops") = false,
+        py::arg("reorder") = "none");
 }
-} // namespace hoshizora
\ No newline at end of file
+} // namespace hoshizora
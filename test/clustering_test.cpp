@@ -0,0 +1,62 @@
+#include "hoshizora/app/apps.h"
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace hoshizora {
+// both directions of each undirected edge, as read from an edge list
+static std::vector<std::pair<u32, u32>>
+mirror(const std::vector<std::pair<u32, u32>> &edges) {
+  std::vector<std::pair<u32, u32>> edge_list;
+  for (const auto &edge : edges) {
+    edge_list.emplace_back(edge.first, edge.second);
+    edge_list.emplace_back(edge.second, edge.first);
+  }
+  return edge_list;
+}
+
+static std::vector<u32> cluster(const std::vector<std::pair<u32, u32>> &edges,
+                                const std::vector<f32> *weights,
+                                const u32 num_clusters_hint) {
+  const auto edge_list = mirror(edges);
+  if (weights == nullptr) {
+    return clustering(ClusteringGraph::from_edge_list(edge_list),
+                      num_clusters_hint, 0.00003);
+  }
+  std::vector<f32> mirrored;
+  for (const auto weight : *weights) {
+    mirrored.emplace_back(weight);
+    mirrored.emplace_back(weight);
+  }
+  return clustering(ClusteringGraph::from_edge_list(edge_list, mirrored),
+                    num_clusters_hint, 0.00003);
+}
+
+// the first level groups both inputs alike, the contracted edges of the
+// second one have to carry the summed weights to tell them apart
+static bool weights_reach_second_level() {
+  const std::vector<std::pair<u32, u32>> edges = {
+      {0, 1},  {0, 3}, {0, 4}, {0, 10}, {0, 11}, {1, 2}, {1, 3},
+      {1, 4},  {2, 3}, {2, 6}, {3, 4},  {3, 7},  {3, 12}, {5, 7},
+      {5, 11}, {6, 7}, {6, 11}, {7, 9}, {8, 11}};
+  const std::vector<f32> weights = {1, 1, 1,   3, 1, 0.5, 1, 3, 1, 1,
+                                    3, 1, 1,   3, 1, 1,   0.5, 3, 1};
+
+  // a hint above #vertices stops after the first level
+  const auto first = cluster(edges, nullptr, 1000);
+  const auto weighted_first = cluster(edges, &weights, 1000);
+  const auto second = cluster(edges, nullptr, 1);
+  const auto weighted_second = cluster(edges, &weights, 1);
+  return first == weighted_first && first != second &&
+         weighted_first != weighted_second && second != weighted_second;
+}
+} // namespace hoshizora
+
+int main() {
+  hoshizora::init();
+  if (!hoshizora::weights_reach_second_level()) {
+    std::fprintf(stderr, "weights do not reach the second level\n");
+    return 1;
+  }
+  return 0;
+}